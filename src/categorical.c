@@ -4,8 +4,11 @@
 #include "ll.h"
 #include "memory.h"
 #include "categorical.h"
+#include "genotypes.h"
+#include "sort.h"
 
 #include <float.h>
+#include <immintrin.h>
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
@@ -22,278 +25,488 @@
         return res; \
     }
 
-static DECLARE_BITS_INIT(uint8_t, gen)
 static DECLARE_BITS_INIT(size_t, phen)
 
-#define GEN_CNT 3
+// Contingency tables are built by the bit counting kernel, if the count of phenotype classes does not exceed this value
+#define PHEN_UCNT_POP_CNT_MAX 16
 
-static size_t gen_pop_cnt_alt_impl(size_t alt, uint8_t *bits, size_t pop_cnt)
-{
-    switch (alt)
-    {
-    case 0: // codominant
-        return pop_cnt;
-    case 1: // recessive
-        return pop_cnt == 2 ? bits[0] == (1 | 4) || bits[0] == (2 | 4) ? 2 : 1 : MIN(pop_cnt, 2);
-    case 2: // dominant
-        return pop_cnt == 2 ? bits[0] == (1 | 2) || bits[0] == (1 | 4) ? 2 : 1 : MIN(pop_cnt, 2);
-    default: // allelic
-        return MIN(pop_cnt, 2);
-    }
-}
+// Otherwise, contingency tables are built by the histogram kernel, if the table has no more than this count of cells.
+// Partial counts are accumulated in several copies of the table to break the dependencies between the consecutive increments
+#define HIST_TABLE_MAX 256
+#define HIST_LANE_CNT 4
 
-static void gen_shuffle_alt_impl(size_t alt, size_t *dst, size_t *src, uint8_t *bits)
+static size_t gen_bits_init(uint8_t *bits, size_t cnt, size_t ucnt, size_t *filter, size_t *gen)
 {
-    switch (alt)
+    size_t res = 0;
+    for (size_t i = 0; i < cnt; i++)
     {
-    case 0: // codominant
-        switch (bits[0])
-        {
-        case (1 | 2 | 4):
-            dst[2] = src[2];
-        case (1 | 2):
-            dst[0] = src[0];
-            dst[1] = src[1];
-            break;
-        case (1 | 4):
-            dst[0] = src[0];
-            dst[1] = src[2];
-            break;
-        case (2 | 4):
-            dst[0] = src[1];
-            dst[1] = src[2];
-            break;
-        }
-        break;
-    case 1: // recessive
-        switch (bits[0])
-        {
-        case (1 | 2 | 4):
-            dst[0] = src[0] + src[1];
-            dst[1] = src[2];
-            break;
-        case (2 | 4):
-            dst[0] = src[1];
-            dst[1] = src[2];
-        case (1 | 4):
-            dst[0] = src[0];
-            dst[1] = src[2];
-            break;
-        }
-        break;
-    case 2: // dominant
-        switch (bits[0])
-        {
-        case (1 | 2 | 4):
-            dst[0] = src[0];
-            dst[1] = src[1] + src[2];
-            break;
-        case (1 | 4):
-            dst[0] = src[0];
-            dst[1] = src[2];
-            break;
-        case (1 | 2):
-            dst[0] = src[0];
-            dst[1] = src[1];
-            break;
-        }
-        break;
-    case 3: // allelic
-        switch (bits[0])
-        {
-        case (1 | 2 | 4):
-            dst[0] = 2 * src[0] + src[1];
-            dst[1] = src[1] + 2 * src[2];
-            break;
-        case (2 | 4):
-            dst[0] = src[1];
-            dst[1] = src[1] + 2 * src[2];
-        case (1 | 4):
-            dst[0] = src[0];
-            dst[1] = src[1];
-            break;
-        case (1 | 2):
-            dst[0] = 2 * src[0] + src[1];
-            dst[1] = src[1];
-            break;
-        }
-        break;
+        if (uint8_bit_test_set(bits, gen_pack_get(gen, filter[i]))) continue;
+        if (++res == ucnt) break;
     }
+    return res;
 }
 
+// Coefficients of the genotypes for the columns of the tables of the alternatives, indexed by the set of genotypes present.
+// Empty columns are dropped, and the alternatives with less than two columns have zero count of columns
+struct gen_alt_map {
+    uint8_t pop_cnt[ALT_CNT], coef[ALT_CNT][GEN_CNT][GEN_CNT];
+};
+
+#define GEN_ALT_REC { { 1, 1, 0 }, { 0, 0, 1 } }
+#define GEN_ALT_DOM { { 1, 0, 0 }, { 0, 1, 1 } }
+#define GEN_ALT_ALL { { 2, 1, 0 }, { 0, 1, 2 } }
+
+static const struct gen_alt_map gen_alt_map[1 << GEN_CNT] = {
+    [1 | 2] = { { 2, 0, 2, 2 }, { { { 1, 0, 0 }, { 0, 1, 0 } }, { { 0 } }, GEN_ALT_DOM, GEN_ALT_ALL } },
+    [1 | 4] = { { 2, 2, 2, 2 }, { { { 1, 0, 0 }, { 0, 0, 1 } }, GEN_ALT_REC, GEN_ALT_DOM, GEN_ALT_ALL } },
+    [2 | 4] = { { 2, 2, 0, 2 }, { { { 0, 1, 0 }, { 0, 0, 1 } }, GEN_ALT_REC, { { 0 } }, GEN_ALT_ALL } },
+    [1 | 2 | 4] = { { 3, 2, 2, 2 }, { { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } }, GEN_ALT_REC, GEN_ALT_DOM, GEN_ALT_ALL } }
+};
+
+// Counts are stored as 32-bit integers. The count of samples should not exceed 'CATEGORICAL_CNT_MAX', since the allelic test doubles 
+// the counts, and the chi-square test forms the signed differences of the products of the doubled counts. Fields of the alternatives are contiguous
 struct categorical_snp_data {
-    size_t gen_mar[GEN_CNT * ALT_CNT], gen_phen_mar[ALT_CNT], cnt, gen_pop_cnt_alt[ALT_CNT], flags_pop_cnt;
+    uint32_t gen_mar[ALT_CNT][GEN_CNT], gen_phen_mar[ALT_CNT], gen_pop_cnt_alt[ALT_CNT];
+    uint32_t lut_disp[ALT_CNT], lut_lo[ALT_CNT], lut_cnt[ALT_CNT]; // Lookup table of the statistic for 2 x 2 tables with fixed margins
+    uint32_t gen_tot[GEN_CNT], cnt, flags_pop_cnt, phen_pop_cnt;
     uint8_t gen_bits[UINT8_CNT(GEN_CNT)];
 };
 
+#define CATEGORICAL_CNT_MAX (UINT32_MAX >> 2)
+
 _Static_assert((2 * GEN_CNT * sizeof(size_t)) / 2 / (GEN_CNT) == sizeof(size_t), "Multiplication overflow!");
+_Static_assert((uint64_t) CATEGORICAL_CNT_MAX * 2 <= UINT32_MAX, "Allelic counts should fit 32 bits!");
+_Static_assert(INT64_MAX / ((int64_t) CATEGORICAL_CNT_MAX * 2) >= (int64_t) CATEGORICAL_CNT_MAX * 2, "Products of the counts and of the margins should fit signed 64 bits!");
 _Static_assert((GEN_CNT * sizeof(double)) / GEN_CNT == sizeof(double), "Multiplication overflow!");
 
-bool categorical_init(struct categorical_supp *supp, size_t phen_cnt, size_t phen_ucnt)
-{
-    if (phen_ucnt > phen_cnt) return 0; // Wrong parameter    
-    supp->phen_mar = malloc(phen_ucnt * sizeof(*supp->phen_mar));
-    supp->phen_bits = malloc(UINT8_CNT(phen_ucnt) * sizeof(*supp->phen_bits));
-    supp->filter = malloc(phen_cnt * sizeof(*supp->filter));
+// Memo of the statistic for the tables with fixed margins. Table is identified by the SNP, the alternative, and the packed free cells
+struct maver_adj_memo {
+    uintptr_t id;
+    uint64_t key;
+    double val;
+};
 
-    if ((!phen_ucnt || (supp->phen_mar && supp->phen_bits)) &&
-        (!phen_cnt || supp->filter) &&
-        array_init(&supp->outer, NULL, phen_ucnt, GEN_CNT * sizeof(*supp->outer), 0, ARRAY_STRICT) &&
-        array_init(&supp->table, NULL, phen_ucnt, 2 * GEN_CNT * sizeof(*supp->table), 0, ARRAY_STRICT)) return 1;
+#define MAVER_ADJ_MEMO_LOG 12
 
-    categorical_close(supp);
-    return 1;
+static void maver_adj_memo_reset(struct maver_adj_thread_supp *thread_supp, size_t thread_cnt)
+{
+    for (size_t i = 0; i < thread_cnt; i++) memset(thread_supp[i].memo, 0, ((size_t) 1 << MAVER_ADJ_MEMO_LOG) * sizeof(*thread_supp[i].memo));
 }
 
-void categorical_close(struct categorical_supp *supp)
+static void maver_adj_thread_close(struct maver_adj_thread_supp *supp)
 {
+    free(supp->tail);
+    free(supp->snp_stat);
+    free(supp->memo);
+    free(supp->hist);
+    free(supp->filter);
+    free(supp->phen_mask);
+    free(supp->perm_bits);
+    free(supp->perm_mask);
+    free(supp->phen_perm);
     free(supp->phen_mar);
     free(supp->phen_bits);
-    free(supp->filter);
     free(supp->outer);
     free(supp->table);
 }
 
-bool maver_adj_init(struct maver_adj_supp *supp, size_t snp_cnt, size_t phen_cnt, size_t phen_ucnt)
+static bool maver_adj_thread_init(struct maver_adj_thread_supp *supp, size_t phen_cnt, size_t phen_ucnt)
 {
-    if (phen_ucnt > phen_cnt) return 0; // Wrong parameter    
-    supp->phen_perm = malloc(phen_cnt * sizeof(*supp->phen_perm));
-    supp->phen_mar = malloc(phen_ucnt * sizeof(*supp->phen_mar));
-    supp->phen_bits = malloc(UINT8_CNT(phen_ucnt) * sizeof(*supp->phen_bits));
-
+    *supp = (struct maver_adj_thread_supp) {
+        .phen_perm = malloc(phen_cnt * sizeof(*supp->phen_perm)),
+        .phen_mar = malloc(ALT_CNT * phen_ucnt * sizeof(*supp->phen_mar)),
+        .phen_bits = malloc(UINT8_CNT(phen_ucnt) * sizeof(*supp->phen_bits))
+    };
     if ((!phen_ucnt || (supp->phen_mar && supp->phen_bits)) &&
         (!phen_cnt || supp->phen_perm) &&
-        array_init(&supp->snp_data, NULL, snp_cnt, sizeof(*supp->snp_data), 0, ARRAY_STRICT) &&
-        array_init(&supp->filter, NULL, snp_cnt * phen_cnt, sizeof(*supp->filter), 0, ARRAY_STRICT) && // Result of 'snp_cnt * phen_cnt' is assumed not to be wrapped due to the validness of the 'gen' array
+        (phen_ucnt > PHEN_UCNT_POP_CNT_MAX || array_init(&supp->phen_mask, NULL, phen_ucnt, TYPE_CNT(phen_cnt, SIZE_BIT) * sizeof(*supp->phen_mask), 0, ARRAY_STRICT)) &&
+        (phen_ucnt != 2 || SIZE_BIT != MAVER_ADJ_BLK || (
+            array_init(&supp->perm_bits, NULL, TYPE_CNT(phen_cnt, SIZE_BIT), SIZE_BIT * sizeof(*supp->perm_bits), 0, ARRAY_STRICT) &&
+            array_init(&supp->perm_mask, NULL, MAVER_ADJ_BLK, TYPE_CNT(phen_cnt, SIZE_BIT) * sizeof(*supp->perm_mask), 0, ARRAY_STRICT))) &&
+        (phen_ucnt <= PHEN_UCNT_POP_CNT_MAX || array_init(&supp->filter, NULL, phen_cnt, sizeof(*supp->filter), 0, ARRAY_STRICT)) &&
+        (phen_ucnt <= PHEN_UCNT_POP_CNT_MAX || GEN_CNT * phen_ucnt > HIST_TABLE_MAX || array_init(&supp->hist, NULL, phen_ucnt, HIST_LANE_CNT * GEN_CNT * sizeof(*supp->hist), 0, ARRAY_STRICT)) &&
+        array_init(&supp->memo, NULL, (size_t) 1 << MAVER_ADJ_MEMO_LOG, sizeof(*supp->memo), 0, ARRAY_STRICT) &&
         array_init(&supp->outer, NULL, phen_ucnt, GEN_CNT * sizeof(*supp->outer), 0, ARRAY_STRICT) &&
-        array_init(&supp->table, NULL, phen_ucnt, 2 * GEN_CNT * sizeof(*supp->table), 0, ARRAY_STRICT)) return 1;
-    
+        array_init(&supp->table, NULL, phen_ucnt, (ALT_CNT + 1) * GEN_CNT * sizeof(*supp->table), 0, ARRAY_STRICT)) return 1;
+
+    maver_adj_thread_close(supp);
+    return 0;
+}
+
+// Heaps of the tail approximation contain one extra statistic, which is used for the choice of the threshold.
+// Cache of the null distribution contains the statistics of all 'rpl' replicates
+bool maver_adj_init(struct maver_adj_supp *supp, size_t snp_cnt, size_t phen_cnt, size_t phen_ucnt, size_t rpl, size_t tail, bool null, size_t thread_cnt)
+{
+    *supp = (struct maver_adj_supp) { .tail = tail };
+    if (phen_ucnt > phen_cnt || phen_cnt > CATEGORICAL_CNT_MAX || !thread_cnt) return 0; // Wrong parameter
+
+    if (array_init(&supp->snp_data, NULL, snp_cnt, sizeof(*supp->snp_data), 0, ARRAY_STRICT) &&
+        array_init(&supp->thread_supp, NULL, thread_cnt, sizeof(*supp->thread_supp), 0, ARRAY_STRICT))
+    {
+        for (; supp->thread_cnt < thread_cnt && maver_adj_thread_init(supp->thread_supp + supp->thread_cnt, phen_cnt, phen_ucnt) &&
+            array_init(&supp->thread_supp[supp->thread_cnt].snp_stat, NULL, snp_cnt, ALT_CNT * sizeof(*supp->thread_supp->snp_stat), 0, ARRAY_STRICT) &&
+            (!tail || array_init(&supp->thread_supp[supp->thread_cnt].tail, NULL, tail + 1, ALT_CNT * sizeof(*supp->thread_supp->tail), 0, ARRAY_STRICT)); supp->thread_cnt++);
+        if (supp->thread_cnt == thread_cnt && 
+            (!tail || array_init(&supp->tail_buff, NULL, thread_cnt * (tail + 1), sizeof(*supp->tail_buff), 0, ARRAY_STRICT)) &&
+            (!null || array_init(&supp->null, NULL, rpl, ALT_CNT * sizeof(*supp->null), 0, ARRAY_STRICT)) &&
+            array_init(&supp->weight, NULL, snp_cnt, sizeof(*supp->weight), 0, ARRAY_STRICT) &&
+            array_init(&supp->snp_ord, NULL, snp_cnt, sizeof(*supp->snp_ord), 0, ARRAY_STRICT))
+        {
+            if (thread_cnt == 1) return 1;
+            size_t blk_cnt = rpl / MAVER_ADJ_BLK + !!(rpl % MAVER_ADJ_BLK);
+            if (array_init(&supp->blk_mask, NULL, blk_cnt, ALT_CNT * sizeof(*supp->blk_mask), 0, ARRAY_STRICT) &&
+                array_init(&supp->blk_bits, NULL, UINT8_CNT(blk_cnt), sizeof(*supp->blk_bits), 0, ARRAY_STRICT) &&
+                mutex_init(&supp->mutex))
+            {
+                if (condition_init(&supp->condition))
+                {
+                    if (array_init(&supp->tasks, NULL, thread_cnt, sizeof(*supp->tasks), 0, ARRAY_STRICT)) return 1;
+                    condition_close(&supp->condition);
+                }
+                mutex_close(&supp->mutex);
+            }
+        }
+    }
     maver_adj_close(supp);
     return 0;
 }
 
 void maver_adj_close(struct maver_adj_supp *supp)
 {
-    free(supp->phen_perm);
-    free(supp->phen_mar);
-    free(supp->phen_bits);
+    if (supp->tasks)
+    {
+        condition_close(&supp->condition);
+        mutex_close(&supp->mutex);
+        free(supp->tasks);
+    }
+    for (size_t i = 0; i < supp->thread_cnt; maver_adj_thread_close(supp->thread_supp + i++));
+    free(supp->thread_supp);
     free(supp->snp_data);
-    free(supp->filter);
-    free(supp->outer);
-    free(supp->table);
+    free(supp->weight);
+    free(supp->tail_buff);
+    free(supp->null);
+    free(supp->snp_ord);
+    free(supp->lut.val);
+    free(supp->blk_mask);
+    free(supp->blk_bits);
 }
 
-static size_t filter_init(size_t *filter, uint8_t *gen, size_t phen_cnt)
+static size_t filter_init(size_t *filter, size_t *gen, size_t phen_cnt)
 {
     size_t cnt = 0;
-    for (size_t i = 0; i < phen_cnt; i++) if (gen[i] < GEN_CNT) filter[cnt++] = i;
+    for (size_t i = 0, j = 0; i < phen_cnt; i += SIZE_BIT, j += 2)
+    {
+        size_t bits = ~(gen[j] & gen[j + 1]), lim = MIN(phen_cnt - i, SIZE_BIT);
+        for (size_t k = 0; k < lim; k++) if (bits & ((size_t) 1 << k)) filter[cnt++] = i + k;
+    }
     return cnt;
 }
 
-static size_t gen_pop_cnt_alt_init(size_t *gen_pop_cnt_alt, uint8_t *gen_bits, size_t gen_pop_cnt, enum categorical_flags flags)
+size_t gen_pop_cnt_alt_init(uint32_t *gen_pop_cnt_alt, uint8_t *gen_bits, enum categorical_flags flags)
 {
     size_t res = 0;
-    for (size_t i = 0; i < ALT_CNT; i++, flags >>= 1) if (flags & 1)
+    const struct gen_alt_map *map = gen_alt_map + gen_bits[0];
+    for (size_t i = 0; i < ALT_CNT; i++, flags >>= 1)
     {
-        size_t tmp = gen_pop_cnt_alt_impl(i, gen_bits, gen_pop_cnt);
-        if (tmp < 2) continue;
+        uint32_t tmp = (uint32_t) (flags & 1) * map->pop_cnt[i];
         gen_pop_cnt_alt[i] = tmp;
-        res++;
+        res += !!tmp;
     }
     return res;
 }
 
-static void contingency_table_init(size_t *table, uint8_t *gen, size_t *phen, size_t cnt, size_t *filter)
+// If 'filter' is NULL, all samples are taken without indirection
+static void contingency_table_init(uint32_t *table, size_t *gen, size_t *phen, size_t cnt, size_t *filter)
 {
-    for (size_t i = 0; i < cnt; i++)
+    if (!filter) for (size_t i = 0; i < cnt; i++) table[gen_pack_get(gen, i) + GEN_CNT * phen[i]]++;
+    else for (size_t i = 0; i < cnt; i++)
     {
         size_t ind = filter[i];
-        table[gen[ind] + GEN_CNT * phen[ind]]++;
+        table[gen_pack_get(gen, ind) + GEN_CNT * phen[ind]]++;
     }
 }
 
-static void contingency_table_shuffle_alt_impl(size_t alt, size_t *dst, size_t *src, uint8_t *gen_bits, size_t gen_pop_cnt, uint8_t *phen_bits, size_t phen_pop_cnt)
+typedef void (*hist_callback)(uint32_t *, size_t *, size_t *, size_t, size_t *, size_t);
+
+static void hist_impl(uint32_t *hist, size_t *gen, size_t *phen, size_t cnt, size_t *filter, size_t disp)
 {
-    size_t off = 0;
-    for (size_t i = 0, j = 0; i < phen_pop_cnt; i++, j += GEN_CNT)
+    size_t i = 0;
+    if (!filter) for (; i + HIST_LANE_CNT <= cnt; i += HIST_LANE_CNT) for (size_t j = 0; j < HIST_LANE_CNT; j++)
+        hist[j * disp + gen_pack_get(gen, i + j) + GEN_CNT * phen[i + j]]++;
+    else for (; i + HIST_LANE_CNT <= cnt; i += HIST_LANE_CNT) for (size_t j = 0; j < HIST_LANE_CNT; j++)
+    {
+        size_t ind = filter[i + j];
+        hist[j * disp + gen_pack_get(gen, ind) + GEN_CNT * phen[ind]]++;
+    }
+    for (; i < cnt; i++)
     {
-        if (!uint8_bit_test(phen_bits, i)) continue;
-        gen_shuffle_alt_impl(alt, dst + off, src + j, gen_bits);
-        off += gen_pop_cnt;
+        size_t ind = filter ? filter[i] : i;
+        hist[gen_pack_get(gen, ind) + GEN_CNT * phen[ind]]++;
     }
 }
 
-static void gen_phen_mar_init(size_t *table, size_t *gen_mar, size_t *phen_mar, size_t *p_gen_phen_mar, size_t gen_pop_cnt, size_t phen_pop_cnt)
+#if SIZE_MAX == UINT64_MAX
+
+// Indices of the cells are computed for four samples at once using gathers of the phenotypes and of the packed genotype words
+static TARGET_AVX2 void hist_impl_avx2(uint32_t *hist, size_t *gen, size_t *phen, size_t cnt, size_t *filter, size_t disp)
 {
-    size_t gen_phen_mar = 0;
-    for (size_t t = 0; t < phen_pop_cnt; gen_phen_mar += phen_mar[t], t++) for (size_t s = 0; s < gen_pop_cnt; s++)
+    _Static_assert(HIST_LANE_CNT == sizeof(__m256i) / sizeof(size_t), "Count of lanes should match the count of 64-bit elements in the register!");
+    const __m256i off = _mm256_set_epi64x((long long) (3 * disp), (long long) (2 * disp), (long long) disp, 0), pos_msk = _mm256_set1_epi64x(SIZE_BIT - 1), gen_msk = _mm256_set1_epi64x(1);
+    const __m256i iota = _mm256_set_epi64x(3, 2, 1, 0), step = _mm256_set1_epi64x(HIST_LANE_CNT);
+    __m256i seq = iota;
+    size_t i = 0;
+    for (; i + HIST_LANE_CNT <= cnt; i += HIST_LANE_CNT, seq = _mm256_add_epi64(seq, step))
+    {
+        __m256i ind = filter ? _mm256_loadu_si256((const __m256i *) (filter + i)) : seq;
+        __m256i p = _mm256_i64gather_epi64((const long long *) phen, ind, sizeof(*phen));
+        __m256i wnd = _mm256_slli_epi64(_mm256_srli_epi64(ind, 6), 1), pos = _mm256_and_si256(ind, pos_msk);
+        __m256i lo = _mm256_and_si256(_mm256_srlv_epi64(_mm256_i64gather_epi64((const long long *) gen, wnd, sizeof(*gen)), pos), gen_msk);
+        __m256i hi = _mm256_and_si256(_mm256_srlv_epi64(_mm256_i64gather_epi64((const long long *) (gen + 1), wnd, sizeof(*gen)), pos), gen_msk);
+        __m256i cell = _mm256_add_epi64(_mm256_add_epi64(_mm256_or_si256(lo, _mm256_slli_epi64(hi, 1)), _mm256_add_epi64(p, _mm256_slli_epi64(p, 1))), off);
+        alignas(sizeof(__m256i)) size_t res[HIST_LANE_CNT];
+        _mm256_store_si256((__m256i *) res, cell);
+        hist[res[0]]++;
+        hist[res[1]]++;
+        hist[res[2]]++;
+        hist[res[3]]++;
+    }
+    for (; i < cnt; i++)
     {
-        size_t el = table[s + gen_pop_cnt * t];
-        gen_mar[s] += el;
-        phen_mar[t] += el;
+        size_t ind = filter ? filter[i] : i;
+        hist[gen_pack_get(gen, ind) + GEN_CNT * phen[ind]]++;
     }
-    *p_gen_phen_mar = gen_phen_mar;
 }
 
-static void phen_mar_init(size_t *table, size_t *phen_mar, size_t gen_pop_cnt, size_t phen_pop_cnt)
+static hist_callback hist_select(void)
 {
-    for (size_t i = 0; i < phen_pop_cnt; i++) for (size_t j = 0; j < gen_pop_cnt; phen_mar[i] += table[j + gen_pop_cnt * i], j++);
+    return cpu_avx2() ? hist_impl_avx2 : hist_impl;
 }
 
-static void outer_prod_chisq_impl(size_t *outer, size_t *gen_mar, size_t *phen_mar, size_t gen_pop_cnt, size_t phen_pop_cnt)
+#else
+
+static hist_callback hist_select(void)
 {
-    for (size_t i = 0; i < phen_pop_cnt; i++) for (size_t j = 0; j < gen_pop_cnt; j++)
-        outer[j + gen_pop_cnt * i] = gen_mar[j] * phen_mar[i];
+    return hist_impl;
 }
 
-static bool outer_prod_combined_impl(size_t *outer, size_t *gen_mar, size_t *phen_mar, size_t gen_phen_mar, size_t gen_pop_cnt, size_t phen_pop_cnt)
+#endif
+
+// Builds contingency table in a single pass over the samples and marks the genotypes and phenotypes being present. 
+// Returns the count of phenotype classes
+static size_t contingency_table_hist(uint32_t *table, uint32_t *hist, uint8_t *gen_bits, uint8_t *phen_bits, size_t *gen, size_t *phen, size_t cnt, size_t *filter, size_t phen_ucnt)
 {
-    if (gen_pop_cnt > 2 || phen_pop_cnt > 2)
+    size_t disp = GEN_CNT * phen_ucnt, phen_cnt = 0, gen_mar[GEN_CNT] = { 0 };
+    memset(hist, 0, HIST_LANE_CNT * disp * sizeof(*hist));
+    hist_select()(hist, gen, phen, cnt, filter, disp);
+    for (size_t i = 0; i < phen_ucnt; i++)
     {
-        outer_prod_chisq_impl(outer, gen_mar, phen_mar, gen_pop_cnt, phen_pop_cnt);
-        return 1;
+        size_t tot = 0;
+        for (size_t j = 0; j < GEN_CNT; j++)
+        {
+            size_t k = i * GEN_CNT + j;
+            uint32_t val = hist[k];
+            for (size_t l = 1; l < HIST_LANE_CNT; val += hist[l++ * disp + k]);
+            table[k] = val;
+            gen_mar[j] += val;
+            tot += val;
+        }
+        if (tot) uint8_bit_set(phen_bits, i), phen_cnt++;
     }
-    size_t lim = 5 * gen_phen_mar;
-    for (size_t i = 0; i < phen_pop_cnt; i++) for (size_t j = 0; j < gen_pop_cnt; j++)
+    for (size_t j = 0; j < GEN_CNT; j++) if (gen_mar[j]) uint8_bit_set(gen_bits, j);
+    return phen_cnt;
+}
+
+// Bit masks of the samples for each phenotype class
+void phen_mask_init(size_t *phen_mask, size_t *phen, size_t phen_cnt, size_t phen_ucnt)
+{
+    size_t wcnt = TYPE_CNT(phen_cnt, SIZE_BIT);
+    memset(phen_mask, 0, phen_ucnt * wcnt * sizeof(*phen_mask));
+    for (size_t i = 0; i < phen_cnt; i++) phen_mask[phen[i] * wcnt + i / SIZE_BIT] |= (size_t) 1 << (i % SIZE_BIT);
+}
+
+// Builds contingency table from the packed genotypes and the phenotype masks. 
+// If 'gen_tot' is provided, the last row of the table is obtained from the totals by subtraction
+void contingency_table_pop_cnt(uint32_t *table, size_t *gen, size_t *phen_mask, uint32_t *gen_tot, size_t phen_cnt, size_t phen_ucnt)
+{
+    size_t wcnt = TYPE_CNT(phen_cnt, SIZE_BIT), cnt = gen_tot ? phen_ucnt - 1 : phen_ucnt;
+    for (size_t i = 0; i < cnt; i++)
+    {
+        size_t *mask = phen_mask + i * wcnt;
+        uint32_t t0 = 0, t1 = 0, t2 = 0;
+        for (size_t j = 0; j < wcnt; j++)
+        {
+            size_t lo = gen[j << 1], hi = gen[(j << 1) + 1], m = mask[j];
+            t0 += (uint32_t) size_pop_cnt(~(lo | hi) & m);
+            t1 += (uint32_t) size_pop_cnt(lo & ~hi & m);
+            t2 += (uint32_t) size_pop_cnt(~lo & hi & m);
+        }
+        table[GEN_CNT * i] = t0;
+        table[GEN_CNT * i + 1] = t1;
+        table[GEN_CNT * i + 2] = t2;
+    }
+    if (!gen_tot) return;
+    for (size_t j = 0; j < GEN_CNT; j++)
+    {
+        uint32_t tot = gen_tot[j];
+        for (size_t i = 0; i < cnt; tot -= table[GEN_CNT * i++ + j]);
+        table[GEN_CNT * cnt + j] = tot;
+    }
+}
+
+static size_t phen_bits_init_from_table(uint8_t *bits, uint32_t *table, size_t phen_ucnt)
+{
+    size_t res = 0;
+    for (size_t i = 0; i < phen_ucnt; i++) if (table[GEN_CNT * i] || table[GEN_CNT * i + 1] || table[GEN_CNT * i + 2]) uint8_bit_set(bits, i), res++;
+    return res;
+}
+
+// Builds the tables of all alternatives and the margins of their rows in a single pass over the base table. Table and row margins of the alternative 'j' 
+// are stored at 'dst + j * GEN_CNT * phen_ucnt' and 'phen_mar + j * phen_ucnt'. Column margins are accumulated only if 'gen_mar' is not NULL.
+// If 'phen_bits' is NULL, all rows are taken
+void contingency_table_alt_init(uint32_t *dst, uint32_t (*gen_mar)[GEN_CNT], uint32_t *phen_mar, uint32_t *src, uint8_t *gen_bits, uint32_t *gen_pop_cnt_alt, uint8_t *phen_bits, size_t phen_ucnt)
+{
+    const struct gen_alt_map *map = gen_alt_map + gen_bits[0];
+    size_t disp = GEN_CNT * phen_ucnt, off = 0;
+    for (size_t i = 0; i < phen_ucnt; i++, src += GEN_CNT)
     {
-        size_t tmp = gen_mar[j] * phen_mar[i];
-        if (tmp >= lim) outer[j + gen_pop_cnt * i] = tmp;
-        else return 0;
+        if (phen_bits && !uint8_bit_test(phen_bits, i)) continue;
+        for (size_t j = 0; j < ALT_CNT; j++)
+        {
+            size_t gen_pop_cnt = gen_pop_cnt_alt[j];
+            uint32_t *row = dst + j * disp + gen_pop_cnt * off, tot = 0;
+            for (size_t k = 0; k < gen_pop_cnt; k++)
+            {
+                uint32_t el = 0;
+                for (size_t l = 0; l < GEN_CNT; l++) el += map->coef[j][k][l] * src[l];
+                row[k] = el;
+                tot += el;
+                if (gen_mar) gen_mar[j][k] += el;
+            }
+            phen_mar[j * phen_ucnt + off] = tot;
+        }
+        off++;
     }
+}
+
+static void outer_prod_chisq_impl(uint64_t *outer, uint32_t *gen_mar, uint32_t *phen_mar, size_t gen_pop_cnt, size_t phen_pop_cnt)
+{
+    for (size_t i = 0; i < phen_pop_cnt; i++) for (size_t j = 0; j < gen_pop_cnt; j++)
+        outer[j + gen_pop_cnt * i] = (uint64_t) gen_mar[j] * phen_mar[i];
+}
+
+// Chi-square test is used for the 2 x 2 tables only if all expected counts are at least 5
+static bool chisq_test(uint32_t *gen_mar, uint32_t *phen_mar, uint64_t gen_phen_mar, size_t gen_pop_cnt, size_t phen_pop_cnt)
+{
+    if (gen_pop_cnt > 2 || phen_pop_cnt > 2) return 1;
+    uint64_t lim = 5 * gen_phen_mar;
+    for (size_t i = 0; i < phen_pop_cnt; i++) for (size_t j = 0; j < gen_pop_cnt; j++)
+        if ((uint64_t) gen_mar[j] * phen_mar[i] < lim) return 0;
     return 1;
 }
 
-double stat_exact(size_t *table, size_t *gen_mar, size_t *phen_mar)
+// Sums hypergeometric probabilities starting from 'k' in the given direction, relative to the probability at 'k'. 
+// Terms are obtained by the ratio recurrence and are non-increasing, provided that 'k' is not on the other side of the mode
+static double stat_exact_tail(size_t k, size_t lo, size_t hi, size_t n1, size_t n2, size_t t, bool dsc)
+{
+    double sum = 1., term = 1.;
+    if (dsc) for (size_t i = k; i > lo && term > 0.; sum += term, i--) term *= (double) i * (double) (n2 - t + i) / ((double) (n1 - i + 1) * (double) (t - i + 1));
+    else for (size_t i = k; i < hi && term > 0.; sum += term, i++) term *= (double) (n1 - i) * (double) (t - i) / ((double) (i + 1) * (double) (n2 - t + i + 1));
+    return sum;
+}
+
+// Two-sided Fisher exact test for 2 x 2 contingency table. Returns '-log10' of the p-value. 
+// The probabilities not exceeding the probability of the observed table form two tails of the distribution, which are summed in the log space
+double stat_exact(uint32_t *table, uint32_t *gen_mar, uint32_t *phen_mar, const double *log_fact)
 {
-    size_t lo = size_sub_sat(gen_mar[0], phen_mar[1]), hi = MIN(gen_mar[0], phen_mar[0]);
-    double hyp_comp = pdf_hypergeom(table[0], phen_mar[0], phen_mar[1], gen_mar[0]), a = 0., b = 0.;
-    for (size_t i = lo; i <= hi; i++)
+    size_t n1 = phen_mar[0], n2 = phen_mar[1], t = gen_mar[0], lo = size_sub_sat(t, n2), hi = MIN(t, n1);
+    size_t mode = (size_t) (((double) t + 1.) * ((double) n1 + 1.) / ((double) n1 + (double) n2 + 2.));
+    mode = MIN(MAX(mode, lo), hi);
+    double lim = log_pdf_hypergeom_tbl(log_fact, table[0], n1, n2, t) + STAT_EXACT_EPS, lp[2] = { -DBL_MAX, -DBL_MAX };
+
+    // Left tail is '[lo, l]', where 'l' is the last point below the mode satisfying the condition
+    if (log_pdf_hypergeom_tbl(log_fact, lo, n1, n2, t) <= lim)
+    {
+        size_t l = lo, r = mode;
+        while (l < r)
+        {
+            size_t m = l + ((r - l + 1) >> 1);
+            if (log_pdf_hypergeom_tbl(log_fact, m, n1, n2, t) <= lim) l = m;
+            else r = m - 1;
+        }
+        lp[0] = log_pdf_hypergeom_tbl(log_fact, l, n1, n2, t) + log(stat_exact_tail(l, lo, hi, n1, n2, t, 1));
+        lo = l + 1; // Points of the left tail are excluded from the right one 
+    }
+
+    // Right tail is '[r, hi]', where 'r' is the first point above the mode satisfying the condition
+    if (lo <= hi && log_pdf_hypergeom_tbl(log_fact, hi, n1, n2, t) <= lim)
     {
-        double hyp = pdf_hypergeom(i, phen_mar[0], phen_mar[1], gen_mar[0]);
-        a += hyp;
-        if (hyp <= hyp_comp) b += hyp;
+        size_t l = MAX(mode, lo), r = hi;
+        while (l < r)
+        {
+            size_t m = l + ((r - l) >> 1);
+            if (log_pdf_hypergeom_tbl(log_fact, m, n1, n2, t) <= lim) r = m;
+            else l = m + 1;
+        }
+        lp[1] = log_pdf_hypergeom_tbl(log_fact, r, n1, n2, t) + log(stat_exact_tail(r, lo, hi, n1, n2, t, 0));
     }
-    return log10(a) - log10(b);
+    
+    double lp_max = MAX(lp[0], lp[1]), res = -(lp_max + log(exp(lp[0] - lp_max) + exp(lp[1] - lp_max))) / 2.3025850929940456840;
+    return MAX(res, 0.);
 }
 
-double qas_exact(size_t *table)
+double qas_exact(uint32_t *table)
 {
     return log10((double) table[0]) + log10((double) table[3]) - (log10((double) table[1]) + log10((double) table[2]));
 }
 
-static double stat_chisq(size_t *table, size_t *outer, size_t gen_phen_mar, size_t gen_pop_cnt, size_t phen_pop_cnt)
+static double stat_chisq(uint32_t *table, uint64_t *outer, uint64_t gen_phen_mar, size_t gen_pop_cnt, size_t phen_pop_cnt)
 {
     double stat = 0.;
     size_t pr = gen_pop_cnt * phen_pop_cnt;
     for (size_t i = 0; i < pr; i++)
     {
-        size_t out = outer[i], diff = out - table[i] * gen_phen_mar;
-        stat += (double) (diff * diff) / (double) (out * gen_phen_mar);
+        int64_t out = (int64_t) outer[i], diff = out - (int64_t) (table[i] * gen_phen_mar);
+        stat += (double) diff * (double) diff / ((double) out * (double) gen_phen_mar);
+    }
+    return cdf_chisq_Q_nlog10(stat, (double) (pr - gen_pop_cnt - phen_pop_cnt + 1));
+}
+
+// Version of 'stat_chisq' for the tables with 'GEN' columns and 'PHEN' rows. Loops have constant bounds and are unrolled by the compiler, 
+// and the outer product is computed in place. Terms are summed in the same order, thus the results are identical
+#define DECLARE_STAT_CHISQ(GEN, PHEN) \
+    double stat_chisq_ ## GEN ## x ## PHEN(const uint32_t *table, const uint32_t *gen_mar, const uint32_t *phen_mar, uint64_t gen_phen_mar) \
+    { \
+        double stat = 0.; \
+        for (size_t t = 0; t < PHEN; t++) for (size_t s = 0; s < GEN; s++) \
+        { \
+            int64_t out = (int64_t) gen_mar[s] * phen_mar[t], diff = out - (int64_t) (table[s + GEN * t] * gen_phen_mar); \
+            stat += (double) diff * (double) diff / ((double) out * (double) gen_phen_mar); \
+        } \
+        return cdf_chisq_Q_nlog10(stat, (double) ((GEN - 1) * (PHEN - 1))); \
     }
-    return -log10(cdf_chisq_Q(stat, (double) (pr - gen_pop_cnt - phen_pop_cnt + 1)));
+
+static DECLARE_STAT_CHISQ(2, 2)
+static DECLARE_STAT_CHISQ(3, 2)
+static DECLARE_STAT_CHISQ(2, 3)
+static DECLARE_STAT_CHISQ(3, 3)
+
+typedef double (*stat_chisq_callback)(const uint32_t *, const uint32_t *, const uint32_t *, uint64_t);
+
+// Kernels indexed by the counts of rows and columns, both decreased by two
+static const stat_chisq_callback stat_chisq_shape[][GEN_CNT - 1] = {
+    { stat_chisq_2x2, stat_chisq_3x2 },
+    { stat_chisq_2x3, stat_chisq_3x3 }
+};
+
+// Selects the kernel by the shape of the table. Generic version is used for the larger counts of phenotype classes, with the outer product stored to 'outer'
+static double stat_chisq_impl(uint32_t *table, uint64_t *outer, uint32_t *gen_mar, uint32_t *phen_mar, uint64_t gen_phen_mar, size_t gen_pop_cnt, size_t phen_pop_cnt)
+{
+    if (phen_pop_cnt - 2 < countof(stat_chisq_shape)) return stat_chisq_shape[phen_pop_cnt - 2][gen_pop_cnt - 2](table, gen_mar, phen_mar, gen_phen_mar);
+    outer_prod_chisq_impl(outer, gen_mar, phen_mar, gen_pop_cnt, phen_pop_cnt);
+    return stat_chisq(table, outer, gen_phen_mar, gen_pop_cnt, phen_pop_cnt);
 }
 
-static double qas_chisq(size_t *table, size_t *gen_mar, size_t *phen_mar, size_t gen_phen_mar, size_t gen_pop_cnt, size_t phen_pop_cnt)
+static double qas_chisq(uint32_t *table, uint32_t *gen_mar, uint32_t *phen_mar, size_t gen_phen_mar, size_t gen_pop_cnt, size_t phen_pop_cnt)
 {
     size_t s = 0, t = 0, s2 = 0, t2 = 0, st = 0;
     for (size_t i = 1; i < phen_pop_cnt; i++)
@@ -307,193 +520,1399 @@ static double qas_chisq(size_t *table, size_t *gen_mar, size_t *phen_mar, size_t
         size_t m = i * gen_mar[i];
         s += m, s2 += i * m;
     }
-    size_t bor;
-    double a = (double) size_sub(&bor, st * gen_phen_mar, s * t), b = sqrt((double) ((s2 * gen_phen_mar - s * s) * (t2 * gen_phen_mar - t * t)));
-    return bor ? .5 * (log10(b + a) - log10(b - a)) : .5 * (log10(b - a) - log10(b + a));
+
+    // Products are of the order of the fourth power of the count of samples, thus they are computed in double
+    double n = (double) gen_phen_mar, a = (double) st * n - (double) s * (double) t, b = sqrt(((double) s2 * n - (double) s * (double) s) * ((double) t2 * n - (double) t * (double) t));
+    return .5 * (log10(b - a) - log10(b + a));
+}
+
+static void categorical_alt_impl(struct categorical_res *res, struct categorical_supp *supp, uint8_t *gen_bits, uint32_t *gen_pop_cnt_alt, size_t phen_pop_cnt, size_t phen_ucnt)
+{
+    uint32_t gen_mar[ALT_CNT][GEN_CNT] = { { 0 } };
+    contingency_table_alt_init(supp->table, gen_mar, supp->phen_mar, supp->table + ALT_CNT * GEN_CNT * phen_ucnt, gen_bits, gen_pop_cnt_alt, supp->phen_bits, phen_ucnt);
+    for (size_t i = 0; i < ALT_CNT; i++)
+    {
+        size_t gen_pop_cnt = gen_pop_cnt_alt[i];
+        if (!gen_pop_cnt) continue;
+        uint32_t *table = supp->table + i * GEN_CNT * phen_ucnt, *phen_mar = supp->phen_mar + i * phen_ucnt, gen_phen_mar = 0;
+        for (size_t t = 0; t < phen_pop_cnt; gen_phen_mar += phen_mar[t++]);
+
+        // Computing test statistic and qas
+        if (chisq_test(gen_mar[i], phen_mar, gen_phen_mar, gen_pop_cnt, phen_pop_cnt))
+        {
+            res->nlpv[i] = stat_chisq_impl(table, supp->outer, gen_mar[i], phen_mar, gen_phen_mar, gen_pop_cnt, phen_pop_cnt);
+            res->qas[i] = qas_chisq(table, gen_mar[i], phen_mar, gen_phen_mar, gen_pop_cnt, phen_pop_cnt);
+        }
+        else
+        {
+            res->nlpv[i] = stat_exact(table, gen_mar[i], phen_mar, supp->log_fact);
+            res->qas[i] = qas_exact(table);
+        }
+    }
 }
 
-static void perm_init(size_t *perm, size_t cnt, gsl_rng *rng)
+// Case/control version of 'categorical_alt_impl'. The table and the margins are kept on the stack
+static void categorical_alt_cc(struct categorical_res *res, struct categorical_supp *supp, uint8_t *gen_bits, uint32_t *gen_pop_cnt_alt, size_t phen_pop_cnt, size_t phen_ucnt)
 {
-    for (size_t i = 0; i < cnt - 1; i++) // Performing 'Knuth shuffle'
+    // One of the classes may be absent due to the missing genotypes
+    if (phen_pop_cnt < 2)
+    {
+        categorical_alt_impl(res, supp, gen_bits, gen_pop_cnt_alt, phen_pop_cnt, phen_ucnt);
+        return;
+    }
+    uint32_t table_alt[ALT_CNT][GEN_CNT * 2], gen_mar_alt[ALT_CNT][GEN_CNT] = { { 0 } }, phen_mar_alt[ALT_CNT][2];
+    contingency_table_alt_init(table_alt[0], gen_mar_alt, phen_mar_alt[0], supp->table + ALT_CNT * GEN_CNT * 2, gen_bits, gen_pop_cnt_alt, NULL, 2);
+    for (size_t i = 0; i < ALT_CNT; i++)
     {
-        size_t j = i + (size_t) floor(gsl_rng_uniform(rng) * (cnt - i));
-        size_t swp = perm[i];
-        perm[i] = perm[j];
-        perm[j] = swp;
+        size_t gen_pop_cnt = gen_pop_cnt_alt[i];
+        if (!gen_pop_cnt) continue;
+        uint32_t *table = table_alt[i], *gen_mar = gen_mar_alt[i], *phen_mar = phen_mar_alt[i], gen_phen_mar = phen_mar[0] + phen_mar[1];
+        if (chisq_test(gen_mar, phen_mar, gen_phen_mar, gen_pop_cnt, 2))
+        {
+            res->nlpv[i] = stat_chisq_shape[0][gen_pop_cnt - 2](table, gen_mar, phen_mar, gen_phen_mar);
+            res->qas[i] = qas_chisq(table, gen_mar, phen_mar, gen_phen_mar, gen_pop_cnt, 2);
+        }
+        else
+        {
+            res->nlpv[i] = stat_exact(table, gen_mar, phen_mar, supp->log_fact);
+            res->qas[i] = qas_exact(table);
+        }
     }
 }
 
-struct categorical_res categorical_impl(struct categorical_supp *supp, uint8_t *gen, size_t *phen, size_t phen_cnt, size_t phen_ucnt, enum categorical_flags flags)
+bool categorical_init(struct categorical_supp *supp, size_t phen_cnt, size_t phen_ucnt)
+{
+    if (phen_ucnt > phen_cnt || phen_cnt > CATEGORICAL_CNT_MAX) return 0; // Wrong parameter    
+    supp->phen_mar = malloc(ALT_CNT * phen_ucnt * sizeof(*supp->phen_mar));
+    supp->phen_bits = malloc(UINT8_CNT(phen_ucnt) * sizeof(*supp->phen_bits));
+    supp->filter = malloc(phen_cnt * sizeof(*supp->filter));
+
+    supp->log_fact = log_fact_tbl_init(2 * phen_cnt); // The allelic test counts two alleles per sample
+    supp->alt = phen_ucnt == 2 ? categorical_alt_cc : categorical_alt_impl;
+
+    if ((!phen_ucnt || (supp->phen_mar && supp->phen_bits)) &&
+        (!phen_cnt || supp->filter) &&
+        supp->log_fact &&
+        (GEN_CNT * phen_ucnt > HIST_TABLE_MAX || array_init(&supp->hist, NULL, phen_ucnt, HIST_LANE_CNT * GEN_CNT * sizeof(*supp->hist), 0, ARRAY_STRICT)) &&
+        array_init(&supp->outer, NULL, phen_ucnt, GEN_CNT * sizeof(*supp->outer), 0, ARRAY_STRICT) &&
+        array_init(&supp->table, NULL, phen_ucnt, (ALT_CNT + 1) * GEN_CNT * sizeof(*supp->table), 0, ARRAY_STRICT)) return 1;
+
+    categorical_close(supp);
+    return 0;
+}
+
+void categorical_close(struct categorical_supp *supp)
+{
+    free(supp->log_fact);
+    free(supp->hist);
+    free(supp->phen_mar);
+    free(supp->phen_bits);
+    free(supp->filter);
+    free(supp->outer);
+    free(supp->table);
+}
+
+struct categorical_res categorical_impl(struct categorical_supp *supp, size_t *gen, size_t *phen, size_t phen_cnt, size_t phen_ucnt, enum categorical_flags flags)
 {    
     struct categorical_res res;
     array_broadcast(res.nlpv, countof(res.nlpv), sizeof(*res.nlpv), &(double) { nan(__func__) });
     array_broadcast(res.qas, countof(res.qas), sizeof(*res.qas), &(double) { nan(__func__) });
 
-    size_t table_disp = GEN_CNT * phen_ucnt;
+    size_t table_disp = ALT_CNT * GEN_CNT * phen_ucnt;
        
     // Initializing genotype filter
     size_t cnt = filter_init(supp->filter, gen, phen_cnt);
     if (!cnt) return res;
     
-    // Counting unique genotypes
     uint8_t gen_bits[UINT8_CNT(GEN_CNT)] = { 0 };
-    size_t gen_pop_cnt_alt[ALT_CNT] = { 0 };
-    if (!gen_pop_cnt_alt_init(gen_pop_cnt_alt, gen_bits, gen_bits_init(gen_bits, cnt, GEN_CNT, supp->filter, gen), flags)) return res;
-    
-    // Counting unique phenotypes
+    uint32_t gen_pop_cnt_alt[ALT_CNT] = { 0 };
+    size_t phen_pop_cnt;
     memset(supp->phen_bits, 0, UINT8_CNT(phen_ucnt));
-    size_t phen_pop_cnt = phen_bits_init(supp->phen_bits, cnt, phen_ucnt, supp->filter, phen);
-    if (phen_pop_cnt < 2) return res;
-
-    // Building contingency table
-    memset(supp->table + table_disp, 0, table_disp * sizeof(*supp->table));
-    contingency_table_init(supp->table + table_disp, gen, phen, cnt, supp->filter);
-
-    // Performing computations for each alternative
-    for (size_t i = 0; i < ALT_CNT; i++)
+    if (supp->hist)
     {
-        size_t gen_pop_cnt = gen_pop_cnt_alt[i];
-        if (!gen_pop_cnt) continue;
-
-        contingency_table_shuffle_alt_impl(i, supp->table, supp->table + table_disp, gen_bits, gen_pop_cnt, supp->phen_bits, phen_pop_cnt);
+        // Building contingency table and counting unique genotypes and phenotypes in a single pass
+        phen_pop_cnt = contingency_table_hist(supp->table + table_disp, supp->hist, gen_bits, supp->phen_bits, gen, phen, cnt, cnt == phen_cnt ? NULL : supp->filter, phen_ucnt);
+        if (!gen_pop_cnt_alt_init(gen_pop_cnt_alt, gen_bits, flags) || phen_pop_cnt < 2) return res;
+    }
+    else
+    {
+        // Counting unique genotypes
+        gen_bits_init(gen_bits, cnt, GEN_CNT, supp->filter, gen);
+        if (!gen_pop_cnt_alt_init(gen_pop_cnt_alt, gen_bits, flags)) return res;
 
-        // Computing sums
-        size_t gen_mar[GEN_CNT] = { 0 }, gen_phen_mar = 0;
-        memset(supp->phen_mar, 0, phen_pop_cnt * sizeof(*supp->phen_mar));
-        gen_phen_mar_init(supp->table, gen_mar, supp->phen_mar, &gen_phen_mar, gen_pop_cnt, phen_pop_cnt);
+        // Counting unique phenotypes
+        phen_pop_cnt = phen_bits_init(supp->phen_bits, cnt, phen_ucnt, supp->filter, phen);
+        if (phen_pop_cnt < 2) return res;
 
-        // Computing test statistic and qas
-        if (outer_prod_combined_impl(supp->outer, gen_mar, supp->phen_mar, gen_phen_mar, gen_pop_cnt, phen_pop_cnt))
-        {
-            res.nlpv[i] = stat_chisq(supp->table, supp->outer, gen_phen_mar, gen_pop_cnt, phen_pop_cnt);
-            res.qas[i] = qas_chisq(supp->table, gen_mar, supp->phen_mar, gen_phen_mar, gen_pop_cnt, phen_pop_cnt);
-        }
-        else
-        {
-            res.nlpv[i] = stat_exact(supp->table, gen_mar, supp->phen_mar);
-            res.qas[i] = qas_exact(supp->table);
-        }
+        // Building contingency table
+        memset(supp->table + table_disp, 0, GEN_CNT * phen_ucnt * sizeof(*supp->table));
+        contingency_table_init(supp->table + table_disp, gen, phen, cnt, cnt == phen_cnt ? NULL : supp->filter);
     }
+
+    supp->alt(&res, supp, gen_bits, gen_pop_cnt_alt, phen_pop_cnt, phen_ucnt);
     return res;
 }
 
-struct maver_adj_res maver_adj_impl(struct maver_adj_supp *supp, uint8_t *gen, size_t *phen, size_t snp_cnt, size_t phen_cnt, size_t phen_ucnt, size_t rpl, size_t k, gsl_rng *rng, enum categorical_flags flags)
+// Simple 'splitmix64' mixing function used to derive the seed of the random number stream for a block of replicates
+static uint64_t seed_mix(uint64_t seed, size_t ind)
 {
-    size_t table_disp = GEN_CNT * phen_ucnt;
-    memset(supp->snp_data, 0, snp_cnt * sizeof(*supp->snp_data));
-
-    //  Initialization
-    double density[ALT_CNT] = { 0. };
-    size_t density_cnt[ALT_CNT] = { 0 };
-
-    for (size_t i = 0, off = 0; i < snp_cnt; i++, off += phen_cnt)
-    {
-        // Initializing genotype filter
-        size_t cnt = filter_init(supp->filter + off, gen + off, phen_cnt);
-        if (!cnt) continue;
-        supp->snp_data[i].cnt = cnt;
-
-        // Counting unique genotypes
-        size_t flags_pop_cnt = gen_pop_cnt_alt_init(supp->snp_data[i].gen_pop_cnt_alt, supp->snp_data[i].gen_bits, gen_bits_init(supp->snp_data[i].gen_bits, cnt, GEN_CNT, supp->filter + off, gen + off), flags);
-        if (!flags_pop_cnt) continue;
-        supp->snp_data[i].flags_pop_cnt = flags_pop_cnt;
+    uint64_t x = seed + ((uint64_t) ind + 1) * 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
 
-        // Counting unique phenotypes
-        memset(supp->phen_bits, 0, UINT8_CNT(phen_ucnt));
-        size_t phen_pop_cnt = phen_bits_init(supp->phen_bits, cnt, phen_ucnt, supp->filter + off, phen);
-        if (phen_pop_cnt < 2) continue;
+struct maver_adj_context {
+    struct maver_adj_supp *supp;
+    struct thread_pool *pool;
+    struct maver_adj_par par;
+    struct maver_adj_ckpt_par *ckpt;
+    size_t *gen, *phen, snp_cnt, phen_cnt, phen_ucnt, rpl, k, blk_cnt;
+    uint64_t seed;
+    double density[ALT_CNT];
+    // Fields below are shared between the threads
+    spinlock_handle spinlock;
+    size_t blk_next, blk_red, qc[ALT_CNT], qt[ALT_CNT], pend;
+    volatile uint8_t stop; // Bits of the alternatives for which the simulations are finished
+};
 
-        // Building contingency table
-        memset(supp->table + table_disp, 0, table_disp * sizeof(*supp->table));
-        contingency_table_init(supp->table + table_disp, gen + off, phen, cnt, supp->filter + off);
+#define ALT_ALL ((1u << ALT_CNT) - 1)
 
-        // Performing computations for each alternative
-        for (size_t j = 0; j < ALT_CNT; j++)
-        {
-            size_t gen_pop_cnt = supp->snp_data[i].gen_pop_cnt_alt[j];
-            if (!gen_pop_cnt) continue;
+// Quantile of the standard normal distribution for the two-sided 95% confidence interval
+#define MAVER_ADJ_Z 1.959963984540054
 
-            contingency_table_shuffle_alt_impl(j, supp->table, supp->table + table_disp, supp->snp_data[i].gen_bits, gen_pop_cnt, supp->phen_bits, phen_pop_cnt);
+// Simulations are stopped after 'k' exceedances (Besag-Clifford rule). Relative standard error of the p-value estimate
+// is then close to '1 / sqrt(k)', thus the relative half-width of the confidence interval does not exceed 'rel_err' for
+// 'k = z^2 / rel_err^2'. Returns zero for non-positive 'rel_err'
+size_t maver_adj_stop_cnt(double rel_err)
+{
+    if (!(rel_err > 0.)) return 0;
+    double k = ceil(MAVER_ADJ_Z * MAVER_ADJ_Z / (rel_err * rel_err));
+    return k < (double) SIZE_MAX ? MAX((size_t) k, 1) : SIZE_MAX;
+}
 
-            // Computing sums
-            memset(supp->phen_mar, 0, phen_pop_cnt * sizeof(*supp->phen_mar));
-            gen_phen_mar_init(supp->table, supp->snp_data[i].gen_mar + j * GEN_CNT, supp->phen_mar, supp->snp_data[i].gen_phen_mar + j, gen_pop_cnt, phen_pop_cnt);
-            outer_prod_chisq_impl(supp->outer, supp->snp_data[i].gen_mar + j * GEN_CNT, supp->phen_mar, gen_pop_cnt, phen_pop_cnt);
-            density[j] += stat_chisq(supp->table, supp->outer, supp->snp_data[i].gen_phen_mar[j], gen_pop_cnt, phen_pop_cnt);
-            density_cnt[j]++;
-        }
+// Wilson score interval for the p-value
+static void maver_adj_ci_impl(double *p_lo, double *p_hi, size_t qc, size_t qt)
+{
+    if (!qt)
+    {
+        *p_lo = *p_hi = nan(__func__);
+        return;
     }
+    double n = (double) qt, p = (double) qc / n, z2 = MAVER_ADJ_Z * MAVER_ADJ_Z, den = 1. + z2 / n;
+    double mid = (p + .5 * z2 / n) / den, rad = MAVER_ADJ_Z * sqrt(p * (1. - p) / n + .25 * z2 / (n * n)) / den;
+    *p_lo = MAX(mid - rad, 0.);
+    *p_hi = MIN(mid + rad, 1.);
+}
 
-    bool alt[ALT_CNT];
-    for (size_t i = 0; i < ALT_CNT; i++, flags >>= 1) alt[i] = (flags & 1) && isfinite(density[i] /= (double) density_cnt[i]);
+// Initializes the data of a single SNP, if the contingency table is built by the bit counting kernel. Returns the count of phenotype classes
+static size_t maver_adj_snp_init_pop_cnt(struct categorical_snp_data *snp_data, struct maver_adj_thread_supp *thread_supp, size_t *gen, size_t phen_cnt, size_t phen_ucnt, enum categorical_flags flags)
+{
+    uint32_t *table = thread_supp->table + ALT_CNT * GEN_CNT * phen_ucnt;
+    contingency_table_pop_cnt(table, gen, thread_supp->phen_mask, NULL, phen_cnt, phen_ucnt);
+    for (size_t i = 0; i < phen_ucnt; i++) for (size_t j = 0; j < GEN_CNT; snp_data->gen_tot[j] += table[GEN_CNT * i + j], j++);
 
-    // Simulations
-    size_t qc[ALT_CNT] = { 0 }, qt[ALT_CNT] = { 0 };
-    for (size_t r = 0; r < rpl; r++)
-    {
-        bool alt_rpl[ALT_CNT], alt_any = 0;
-        for (size_t i = 0; i < ALT_CNT; i++) alt_any |= (alt_rpl[i] = alt[i] && (!k || qc[i] < k)); // Adaptive mode for positive parameter 'k'
-        if (!alt_any) break;
+    // Counting unique genotypes
+    for (size_t j = 0; j < GEN_CNT; j++) if (snp_data->gen_tot[j]) uint8_bit_set(snp_data->gen_bits, j), snp_data->cnt += snp_data->gen_tot[j];
+    if (!snp_data->cnt || !(snp_data->flags_pop_cnt = (uint32_t) gen_pop_cnt_alt_init(snp_data->gen_pop_cnt_alt, snp_data->gen_bits, flags))) return 0;
 
-        // Generating random permutation
-        memcpy(supp->phen_perm, phen, phen_cnt * sizeof(*supp->phen_perm));
-        perm_init(supp->phen_perm, phen_cnt, rng);
-        
-        // Density computation
-        double density_perm[ALT_CNT] = { 0. };
-        size_t density_perm_cnt[ALT_CNT] = { 0 };
+    // Counting unique phenotypes
+    memset(thread_supp->phen_bits, 0, UINT8_CNT(phen_ucnt));
+    return phen_bits_init_from_table(thread_supp->phen_bits, table, phen_ucnt);
+}
 
-        for (size_t i = 0, off = 0; i < snp_cnt; i++, off += phen_cnt)
-        {
-            size_t cnt = supp->snp_data[i].cnt;
-            if (!cnt || !supp->snp_data[i].flags_pop_cnt) continue;
+// Initializes the data of a single SNP, if the contingency table is built using the genotype filter. Returns the count of phenotype classes
+static size_t maver_adj_snp_init_filter(struct categorical_snp_data *snp_data, struct maver_adj_thread_supp *thread_supp, size_t *gen, size_t *phen, size_t phen_cnt, size_t phen_ucnt, enum categorical_flags flags)
+{
+    // Initializing genotype filter
+    size_t *filter = thread_supp->filter, cnt = filter_init(filter, gen, phen_cnt);
+    if (!cnt) return 0;
+    snp_data->cnt = (uint32_t) cnt;
+    size_t table_disp = ALT_CNT * GEN_CNT * phen_ucnt;
+    memset(thread_supp->phen_bits, 0, UINT8_CNT(phen_ucnt));
+    if (thread_supp->hist)
+    {
+        // Building contingency table and counting unique genotypes and phenotypes in a single pass
+        size_t phen_pop_cnt = contingency_table_hist(thread_supp->table + table_disp, thread_supp->hist, snp_data->gen_bits, thread_supp->phen_bits, gen, phen, cnt, filter, phen_ucnt);
+        return (snp_data->flags_pop_cnt = (uint32_t) gen_pop_cnt_alt_init(snp_data->gen_pop_cnt_alt, snp_data->gen_bits, flags)) ? phen_pop_cnt : 0;
+    }
 
-            // Counting unique phenotypes
-            memset(supp->phen_bits, 0, UINT8_CNT(phen_ucnt));
-            size_t phen_pop_cnt = phen_bits_init(supp->phen_bits, cnt, phen_ucnt, supp->filter + off, supp->phen_perm);
-            if (phen_pop_cnt < 2) continue;
+    // Counting unique genotypes
+    gen_bits_init(snp_data->gen_bits, cnt, GEN_CNT, filter, gen);
+    size_t flags_pop_cnt = gen_pop_cnt_alt_init(snp_data->gen_pop_cnt_alt, snp_data->gen_bits, flags);
+    if (!flags_pop_cnt) return 0;
+    snp_data->flags_pop_cnt = (uint32_t) flags_pop_cnt;
 
-            // Building contingency table
-            memset(supp->table + table_disp, 0, table_disp * sizeof(*supp->table));
-            contingency_table_init(supp->table + table_disp, gen + off, supp->phen_perm, cnt, supp->filter + off);
+    // Counting unique phenotypes
+    size_t phen_pop_cnt = phen_bits_init(thread_supp->phen_bits, cnt, phen_ucnt, filter, phen);
+    if (phen_pop_cnt < 2) return phen_pop_cnt;
 
-            // Performing computations for each alternative
-            for (size_t j = 0; j < ALT_CNT; j++) if (alt_rpl[j])
-            {
-                size_t gen_pop_cnt = supp->snp_data[i].gen_pop_cnt_alt[j];
-                if (!gen_pop_cnt) continue;
+    // Building contingency table
+    memset(thread_supp->table + table_disp, 0, GEN_CNT * phen_ucnt * sizeof(*thread_supp->table));
+    contingency_table_init(thread_supp->table + table_disp, gen, phen, cnt, filter);
+    return phen_pop_cnt;
+}
 
-                contingency_table_shuffle_alt_impl(j, supp->table, supp->table + table_disp, supp->snp_data[i].gen_bits, gen_pop_cnt, supp->phen_bits, phen_pop_cnt);
+// Lookup table covers this count of standard deviations of the upper left cell around its mean
+#define MAVER_ADJ_LUT_SD 6.
 
-                // Computing sums
-                memset(supp->phen_mar, 0, phen_pop_cnt * sizeof(*supp->phen_mar));
-                phen_mar_init(supp->table, supp->phen_mar, gen_pop_cnt, phen_pop_cnt);
-                outer_prod_chisq_impl(supp->outer, supp->snp_data[i].gen_mar + j * GEN_CNT, supp->phen_mar, gen_pop_cnt, phen_pop_cnt);
-                density_perm[j] += stat_chisq(supp->table, supp->outer, supp->snp_data[i].gen_phen_mar[j], gen_pop_cnt, phen_pop_cnt);
-                density_perm_cnt[j]++;
+// Builds lookup table of the statistic for the 2 x 2 table with fixed margins, which is determined by the upper left cell.
+// Table is built only if its size does not exceed the count of replicates
+static void maver_adj_lut_init(struct maver_adj_lut *lut, struct categorical_snp_data *snp_data, uint32_t *phen_mar, size_t alt, size_t rpl)
+{
+    size_t n = snp_data->gen_phen_mar[alt], g0 = snp_data->gen_mar[alt][0], p0 = phen_mar[0], p1 = phen_mar[1];
+    double mean = (double) g0 * (double) p0 / (double) n, sd = sqrt(mean * (double) p1 / (double) n * (double) (n - g0) / (double) (n - 1));
+    size_t rad = (size_t) ceil(MAVER_ADJ_LUT_SD * sd) + 1, mid = (size_t) mean;
+    size_t lo = MAX(size_sub_sat(g0, p1), size_sub_sat(mid, rad)), hi = MIN(MIN(g0, p0), mid + rad), cnt = hi - lo + 1;
+    if (lo > hi || cnt > rpl || lut->cnt + cnt > UINT32_MAX || !array_test(&lut->val, &lut->cap, sizeof(*lut->val), 0, 0, lut->cnt, cnt)) return;
+    for (size_t i = 0; i < cnt; i++)
+    {
+        uint32_t x = (uint32_t) (lo + i), table[] = { x, (uint32_t) (p0 - x), (uint32_t) (g0 - x), (uint32_t) (p1 - g0 + x) };
+        lut->val[lut->cnt + i] = stat_chisq_2x2(table, snp_data->gen_mar[alt], phen_mar, n);
+    }
+    snp_data->lut_disp[alt] = (uint32_t) lut->cnt;
+    snp_data->lut_lo[alt] = (uint32_t) lo;
+    snp_data->lut_cnt[alt] = (uint32_t) cnt;
+    lut->cnt += cnt;
+}
+
+// Initializes SNPs of the range and accumulates the observed statistics. Phenotype masks are assumed to be initialized by the caller.
+// If 'snp_stat' is provided, the statistics are also stored per SNP
+static void maver_adj_init_range(struct categorical_snp_data *snp_data, struct maver_adj_lut *lut, struct maver_adj_thread_supp *thread_supp, size_t *gen, size_t *phen, size_t snp_cnt, size_t phen_cnt, size_t phen_ucnt, size_t rpl, double *density, size_t *density_cnt, double *snp_stat, enum categorical_flags flags)
+{
+    size_t table_disp = GEN_CNT * phen_ucnt, gen_disp = gen_pack_cnt(phen_cnt);
+    bool pop_cnt = phen_ucnt <= PHEN_UCNT_POP_CNT_MAX;
+    memset(snp_data, 0, snp_cnt * sizeof(*snp_data));
+    for (size_t i = 0; i < snp_cnt; i++)
+    {
+        size_t phen_pop_cnt = pop_cnt ?
+            maver_adj_snp_init_pop_cnt(snp_data + i, thread_supp, gen + i * gen_disp, phen_cnt, phen_ucnt, flags) :
+            maver_adj_snp_init_filter(snp_data + i, thread_supp, gen + i * gen_disp, phen, phen_cnt, phen_ucnt, flags);
+        snp_data[i].phen_pop_cnt = (uint32_t) phen_pop_cnt;
+        if (phen_pop_cnt < 2) continue;
+
+        // Performing computations for each alternative
+        contingency_table_alt_init(thread_supp->table, snp_data[i].gen_mar, thread_supp->phen_mar, thread_supp->table + ALT_CNT * table_disp, snp_data[i].gen_bits, snp_data[i].gen_pop_cnt_alt, thread_supp->phen_bits, phen_ucnt);
+        for (size_t j = 0; j < ALT_CNT; j++)
+        {
+            size_t gen_pop_cnt = snp_data[i].gen_pop_cnt_alt[j];
+            if (!gen_pop_cnt) continue;
+            uint32_t *table = thread_supp->table + j * table_disp, *phen_mar = thread_supp->phen_mar + j * phen_ucnt;
+            for (size_t t = 0; t < phen_pop_cnt; snp_data[i].gen_phen_mar[j] += phen_mar[t++]);
+            double stat = stat_chisq_impl(table, thread_supp->outer, snp_data[i].gen_mar[j], phen_mar, snp_data[i].gen_phen_mar[j], gen_pop_cnt, phen_pop_cnt);
+            if (snp_stat) snp_stat[i * ALT_CNT + j] = stat;
+            density[j] += stat;
+            density_cnt[j]++;
+
+            // Margins are fixed under permutations for SNPs without missing calls
+            if (snp_data[i].cnt == phen_cnt && gen_pop_cnt == 2 && phen_pop_cnt == 2) maver_adj_lut_init(lut, snp_data + i, phen_mar, j, rpl);
+        }
+    }
+}
+
+// Normalizes densities. Returns bits of the alternatives which should not be simulated
+static uint8_t maver_adj_stop_init(double *density, size_t *density_cnt, enum categorical_flags flags)
+{
+    uint8_t stop = 0;
+    for (size_t i = 0; i < ALT_CNT; i++, flags >>= 1)
+        if (!((flags & 1) && isfinite(density[i] /= (double) density_cnt[i]))) stop |= 1 << i;
+    return stop;
+}
+
+// Maximal density over the windows of 'wnd' consecutive SNPs. The sum and the count of the statistics of the window are updated in O(1) 
+// per shift. SNPs without statistic are not counted. The result is NaN if none of the windows contains a statistic
+static void maver_adj_mov_max(double *density, const double *snp_stat, size_t snp_cnt, size_t wnd, const bool *alt)
+{
+    size_t lim = MIN(wnd, snp_cnt);
+    for (size_t j = 0; j < ALT_CNT; j++) if (alt[j])
+    {
+        double sum = 0., max = nan(__func__);
+        size_t cnt = 0;
+        for (size_t i = 0; i < snp_cnt; i++)
+        {
+            double x = snp_stat[i * ALT_CNT + j];
+            if (!isnan(x)) sum += x, cnt++;
+            if (i >= wnd)
+            {
+                double y = snp_stat[(i - wnd) * ALT_CNT + j];
+                if (!isnan(y)) sum -= y, cnt--;
+            }
+            if (i + 1 < lim || !cnt) continue;
+            double tmp = sum / (double) cnt;
+            if (!(tmp <= max)) max = tmp;
+        }
+        density[j] = max;
+    }
+}
+
+// Weights of the SNPs are given by the normal density at the offset from the middle of the range
+static void maver_adj_weight_init(double *weight, size_t snp_cnt, double sd)
+{
+    double mid = .5 * (double) (snp_cnt - 1), norm = 1. / (sd * 2.5066282746310002416);
+    for (size_t i = 0; i < snp_cnt; i++)
+    {
+        double x = ((double) i - mid) / sd;
+        weight[i] = norm * exp(-.5 * x * x);
+    }
+}
+
+// Kernel-weighted sum of the statistics. Statistics of all alternatives for a SNP are stored contiguously, thus the inner loop is vectorized
+static void maver_adj_kernel_sum(double *density, const double *snp_stat, const double *weight, size_t snp_cnt)
+{
+    double sum[ALT_CNT] = { 0. };
+    for (size_t i = 0; i < snp_cnt; i++) for (size_t j = 0; j < ALT_CNT; j++) sum[j] += weight[i] * snp_stat[i * ALT_CNT + j];
+    memcpy(density, sum, sizeof(sum));
+}
+
+// Reduces the vector of statistics of the SNPs to the statistic of the range. Missing values are zeros in the kernel mode and NaN's otherwise
+static void maver_adj_reduce(struct maver_adj_context *context, double *density, size_t *density_cnt, const double *snp_stat, const bool *alt)
+{
+    if (context->par.type == MAVER_ADJ_TYPE_KERNEL) maver_adj_kernel_sum(density, snp_stat, context->supp->weight, context->snp_cnt);
+    else maver_adj_mov_max(density, snp_stat, context->snp_cnt, context->par.wnd, alt);
+    for (size_t i = 0; i < ALT_CNT; density_cnt[i++] = 1);
+}
+
+struct maver_adj_ord_context {
+    const double *snp_stat;
+    const bool *alt;
+};
+
+// Maximal statistic of the SNP over the alternatives being tested
+static double maver_adj_ord_key(const double *snp_stat, const bool *alt)
+{
+    double res = -HUGE_VAL;
+    for (size_t i = 0; i < ALT_CNT; i++) if (alt[i] && snp_stat[i] > res) res = snp_stat[i];
+    return res;
+}
+
+static bool maver_adj_ord_cmp(const void *A, const void *B, void *Context)
+{
+    struct maver_adj_ord_context *context = Context;
+    size_t a = *(const size_t *) A, b = *(const size_t *) B;
+    double ka = maver_adj_ord_key(context->snp_stat + a * ALT_CNT, context->alt), kb = maver_adj_ord_key(context->snp_stat + b * ALT_CNT, context->alt);
+    return kb > ka || (kb == ka && a > b);
+}
+
+// Observed maximal statistics. SNPs are ordered by their observed statistics in the descending order
+static void maver_adj_max_init(struct maver_adj_context *context, double *density, const double *snp_stat, const bool *alt)
+{
+    size_t *snp_ord = context->supp->snp_ord;
+    for (size_t j = 0; j < ALT_CNT; density[j++] = -HUGE_VAL);
+    for (size_t i = 0; i < context->snp_cnt; i++)
+    {
+        for (size_t j = 0; j < ALT_CNT; j++) if (snp_stat[i * ALT_CNT + j] > density[j]) density[j] = snp_stat[i * ALT_CNT + j];
+        snp_ord[i] = i;
+    }
+    quick_sort(snp_ord, context->snp_cnt, sizeof(*snp_ord), maver_adj_ord_cmp, &(struct maver_adj_ord_context) { .snp_stat = snp_stat, .alt = alt });
+}
+
+static void maver_adj_snp_stat_reset(struct maver_adj_context *context, double *snp_stat)
+{
+    double val = context->par.type == MAVER_ADJ_TYPE_KERNEL ? 0. : nan(__func__);
+    array_broadcast(snp_stat, context->snp_cnt * ALT_CNT, sizeof(*snp_stat), &val);
+}
+
+// Generates random permutation of phenotypes
+static void maver_adj_perm_impl(struct maver_adj_thread_supp *thread_supp, size_t *phen, size_t phen_cnt, size_t phen_ucnt)
+{
+    memcpy(thread_supp->phen_perm, phen, phen_cnt * sizeof(*thread_supp->phen_perm));
+    rng_shuffle(&thread_supp->rng, thread_supp->phen_perm, phen_cnt);
+    if (phen_ucnt <= PHEN_UCNT_POP_CNT_MAX) phen_mask_init(thread_supp->phen_mask, thread_supp->phen_perm, phen_cnt, phen_ucnt);
+}
+
+// Packs free cells of the table with fixed margins to the key. Returns 0 if the key does not fit
+static bool maver_adj_memo_key(uint64_t *p_key, uint32_t *table, size_t gen_pop_cnt, size_t phen_pop_cnt, size_t bits)
+{
+    uint64_t key = 0;
+    size_t off = 0;
+    for (size_t t = 0; t < phen_pop_cnt - 1; t++) for (size_t s = 0; s < gen_pop_cnt - 1; s++, off += bits)
+    {
+        if (off + bits > sizeof(key) * CHAR_BIT) return 0;
+        key |= (uint64_t) table[s + gen_pop_cnt * t] << off;
+    }
+    *p_key = key;
+    return 1;
+}
+
+static struct maver_adj_memo *maver_adj_memo_fetch(struct maver_adj_memo *memo, uintptr_t id, uint64_t key)
+{
+    uint64_t h = (key ^ ((uint64_t) id * 0x9e3779b97f4a7c15ull)) * 0xbf58476d1ce4e5b9ull;
+    return memo + (size_t) (h >> (sizeof(h) * CHAR_BIT - MAVER_ADJ_MEMO_LOG));
+}
+
+static double maver_adj_stat_impl(struct categorical_snp_data *snp_data, struct maver_adj_thread_supp *thread_supp, uint32_t *table, uint32_t *phen_mar, size_t alt, size_t gen_pop_cnt, size_t phen_pop_cnt)
+{
+    return stat_chisq_impl(table, thread_supp->outer, snp_data->gen_mar[alt], phen_mar, snp_data->gen_phen_mar[alt], gen_pop_cnt, phen_pop_cnt);
+}
+
+// Counts of columns of the alternatives to be simulated
+static void maver_adj_gen_pop_cnt_rpl(uint32_t *gen_pop_cnt_rpl, struct categorical_snp_data *snp_data, bool *alt_rpl)
+{
+    for (size_t j = 0; j < ALT_CNT; j++) gen_pop_cnt_rpl[j] = alt_rpl[j] * snp_data->gen_pop_cnt_alt[j];
+}
+
+// Statistic of the alternative 'alt' of the SNP is taken from the lookup table or from the memo, if the margins are fixed. 
+// The result is accumulated, and it is also stored to 'snp_stat', if provided
+static inline void maver_adj_stat_acc(struct categorical_snp_data *snp_data, const double *lut, struct maver_adj_thread_supp *thread_supp, uint32_t *table, uint32_t *phen_mar, size_t alt, size_t gen_pop_cnt, size_t phen_pop_cnt, size_t phen_cnt, size_t bits, double *density_perm, size_t *density_perm_cnt, double *snp_stat)
+{
+    double stat;
+    uint64_t key;
+    size_t x = table[0] - snp_data->lut_lo[alt];
+    if (x < snp_data->lut_cnt[alt]) stat = lut[snp_data->lut_disp[alt] + x];
+    else if (snp_data->cnt == phen_cnt && maver_adj_memo_key(&key, table, gen_pop_cnt, phen_pop_cnt, bits))
+    {
+        uintptr_t id = (uintptr_t) snp_data + alt;
+        struct maver_adj_memo *memo = maver_adj_memo_fetch(thread_supp->memo, id, key);
+        if (memo->id != id || memo->key != key) *memo = (struct maver_adj_memo) { .id = id, .key = key, .val = maver_adj_stat_impl(snp_data, thread_supp, table, phen_mar, alt, gen_pop_cnt, phen_pop_cnt) };
+        stat = memo->val;
+    }
+    else stat = maver_adj_stat_impl(snp_data, thread_supp, table, phen_mar, alt, gen_pop_cnt, phen_pop_cnt);
+    if (snp_stat) snp_stat[alt] = stat;
+    density_perm[alt] += stat;
+    density_perm_cnt[alt]++;
+}
+
+// Computes statistics of a single SNP for each alternative from the contingency table built by the caller. If 'snp_stat' is provided, the statistics are also stored
+static void maver_adj_rpl_alt(struct categorical_snp_data *snp_data, const double *lut, struct maver_adj_thread_supp *thread_supp, size_t phen_cnt, size_t phen_ucnt, size_t phen_pop_cnt, size_t bits, bool *alt_rpl, double *density_perm, size_t *density_perm_cnt, double *snp_stat)
+{
+    size_t disp = GEN_CNT * phen_ucnt;
+    uint32_t gen_pop_cnt_rpl[ALT_CNT];
+    maver_adj_gen_pop_cnt_rpl(gen_pop_cnt_rpl, snp_data, alt_rpl);
+    contingency_table_alt_init(thread_supp->table, NULL, thread_supp->phen_mar, thread_supp->table + ALT_CNT * disp, snp_data->gen_bits, gen_pop_cnt_rpl, thread_supp->phen_bits, phen_ucnt);
+    for (size_t j = 0; j < ALT_CNT; j++)
+    {
+        size_t gen_pop_cnt = gen_pop_cnt_rpl[j];
+        if (gen_pop_cnt) maver_adj_stat_acc(snp_data, lut, thread_supp, thread_supp->table + j * disp, thread_supp->phen_mar + j * phen_ucnt, j, gen_pop_cnt, phen_pop_cnt, phen_cnt, bits, density_perm, density_perm_cnt, snp_stat);
+    }
+}
+
+// Case/control version of 'maver_adj_rpl_alt'. Tables of the alternatives are kept on the stack
+static void maver_adj_rpl_alt_cc(struct categorical_snp_data *snp_data, const double *lut, struct maver_adj_thread_supp *thread_supp, size_t phen_cnt, size_t phen_ucnt, size_t phen_pop_cnt, size_t bits, bool *alt_rpl, double *density_perm, size_t *density_perm_cnt, double *snp_stat)
+{
+    // One of the classes may be absent due to the missing genotypes
+    if (phen_pop_cnt < 2)
+    {
+        maver_adj_rpl_alt(snp_data, lut, thread_supp, phen_cnt, phen_ucnt, phen_pop_cnt, bits, alt_rpl, density_perm, density_perm_cnt, snp_stat);
+        return;
+    }
+    uint32_t gen_pop_cnt_rpl[ALT_CNT], table_alt[ALT_CNT][GEN_CNT * 2], phen_mar_alt[ALT_CNT][2];
+    maver_adj_gen_pop_cnt_rpl(gen_pop_cnt_rpl, snp_data, alt_rpl);
+    contingency_table_alt_init(table_alt[0], NULL, phen_mar_alt[0], thread_supp->table + ALT_CNT * GEN_CNT * 2, snp_data->gen_bits, gen_pop_cnt_rpl, NULL, 2);
+    for (size_t j = 0; j < ALT_CNT; j++)
+    {
+        size_t gen_pop_cnt = gen_pop_cnt_rpl[j];
+        if (gen_pop_cnt) maver_adj_stat_acc(snp_data, lut, thread_supp, table_alt[j], phen_mar_alt[j], j, gen_pop_cnt, 2, phen_cnt, bits, density_perm, density_perm_cnt, snp_stat);
+    }
+}
+
+static maver_adj_alt_callback maver_adj_alt_select(size_t phen_ucnt)
+{
+    return phen_ucnt == 2 ? maver_adj_rpl_alt_cc : maver_adj_rpl_alt;
+}
+
+static void maver_adj_init_impl(struct maver_adj_context *context, bool *alt, enum categorical_flags flags)
+{
+    struct maver_adj_supp *supp = context->supp;
+    struct maver_adj_thread_supp *thread_supp = supp->thread_supp;
+    if (context->phen_ucnt <= PHEN_UCNT_POP_CNT_MAX) phen_mask_init(thread_supp->phen_mask, context->phen, context->phen_cnt, context->phen_ucnt);
+    size_t density_cnt[ALT_CNT] = { 0 };
+    supp->lut.cnt = 0;
+    maver_adj_memo_reset(supp->thread_supp, supp->thread_cnt);
+    for (size_t i = 0; i < supp->thread_cnt; i++) supp->thread_supp[i].rpl_alt = maver_adj_alt_select(context->phen_ucnt);
+    for (size_t i = 0; i < supp->thread_cnt; i++) memset(supp->thread_supp[i].tail_cnt, 0, sizeof(supp->thread_supp[i].tail_cnt));
+    if (context->par.type == MAVER_ADJ_TYPE_MEAN) maver_adj_init_range(supp->snp_data, &supp->lut, thread_supp, context->gen, context->phen, context->snp_cnt, context->phen_cnt, context->phen_ucnt, context->rpl, context->density, density_cnt, NULL, flags);
+    else
+    {
+        // Weights are computed once per range and are shared by all replicates
+        bool alt_flags[ALT_CNT];
+        for (size_t i = 0; i < ALT_CNT; i++) alt_flags[i] = flags & (1 << i);
+        if (context->par.type == MAVER_ADJ_TYPE_KERNEL) maver_adj_weight_init(supp->weight, context->snp_cnt, context->par.sd);
+        maver_adj_snp_stat_reset(context, thread_supp->snp_stat);
+        maver_adj_init_range(supp->snp_data, &supp->lut, thread_supp, context->gen, context->phen, context->snp_cnt, context->phen_cnt, context->phen_ucnt, context->rpl, context->density, density_cnt, thread_supp->snp_stat, flags);
+        if (context->par.type == MAVER_ADJ_TYPE_MAX)
+        {
+            maver_adj_max_init(context, context->density, thread_supp->snp_stat, alt_flags);
+            for (size_t i = 0; i < ALT_CNT; density_cnt[i++] = 1);
+        }
+        else maver_adj_reduce(context, context->density, density_cnt, thread_supp->snp_stat, alt_flags);
+    }
+    uint8_t stop = maver_adj_stop_init(context->density, density_cnt, flags);
+    for (size_t i = 0; i < ALT_CNT; i++) alt[i] = !(stop & (1 << i));
+    memcpy(supp->density, context->density, sizeof(supp->density));
+    context->stop = stop;
+    context->blk_cnt = context->rpl / MAVER_ADJ_BLK + !!(context->rpl % MAVER_ADJ_BLK);
+}
+
+// Accumulates statistics of the SNPs of the range for the current permutation of phenotypes. If 'snp_stat' is provided, the statistics are also stored per SNP
+static void maver_adj_rpl_range(struct categorical_snp_data *snp_data, const double *lut, struct maver_adj_thread_supp *thread_supp, size_t *gen, size_t snp_cnt, size_t phen_cnt, size_t phen_ucnt, bool *alt_rpl, double *density_perm, size_t *density_perm_cnt, double *snp_stat)
+{
+    size_t table_disp = ALT_CNT * GEN_CNT * phen_ucnt, gen_disp = gen_pack_cnt(phen_cnt), bits = size_bit_scan_reverse(phen_cnt) + 1;
+    bool pop_cnt = phen_ucnt <= PHEN_UCNT_POP_CNT_MAX;
+    for (size_t i = 0; i < snp_cnt; i++)
+    {
+        // Count of phenotype classes is invariant under permutations for the SNPs without missing calls
+        size_t cnt = snp_data[i].cnt;
+        bool full = cnt == phen_cnt;
+        if (!cnt || !snp_data[i].flags_pop_cnt || (full && snp_data[i].phen_pop_cnt < 2)) continue;
+
+        // Counting unique phenotypes and building contingency table
+        size_t phen_pop_cnt;
+        memset(thread_supp->phen_bits, 0, UINT8_CNT(phen_ucnt));
+        if (pop_cnt)
+        {
+            contingency_table_pop_cnt(thread_supp->table + table_disp, gen + i * gen_disp, thread_supp->phen_mask, snp_data[i].gen_tot, phen_cnt, phen_ucnt);
+            phen_pop_cnt = phen_bits_init_from_table(thread_supp->phen_bits, thread_supp->table + table_disp, phen_ucnt);
+            if (phen_pop_cnt < 2) continue;
+        }
+        else
+        {
+            // Genotype filter is rebuilt from the packed genotypes only for the SNPs with missing calls
+            size_t *filter = NULL;
+            if (!full) filter_init(filter = thread_supp->filter, gen + i * gen_disp, phen_cnt);
+            if (thread_supp->hist)
+            {
+                uint8_t gen_bits[UINT8_CNT(GEN_CNT)] = { 0 };
+                phen_pop_cnt = contingency_table_hist(thread_supp->table + table_disp, thread_supp->hist, gen_bits, thread_supp->phen_bits, gen + i * gen_disp, thread_supp->phen_perm, cnt, filter, phen_ucnt);
             }
+            else
+            {
+                memset(thread_supp->table + table_disp, 0, GEN_CNT * phen_ucnt * sizeof(*thread_supp->table));
+                contingency_table_init(thread_supp->table + table_disp, gen + i * gen_disp, thread_supp->phen_perm, cnt, filter);
+                phen_pop_cnt = phen_bits_init_from_table(thread_supp->phen_bits, thread_supp->table + table_disp, phen_ucnt);
+            }
+            if (phen_pop_cnt < 2) continue;
         }
 
+        thread_supp->rpl_alt(snp_data + i, lut, thread_supp, phen_cnt, phen_ucnt, phen_pop_cnt, bits, alt_rpl, density_perm, density_perm_cnt, snp_stat ? snp_stat + i * ALT_CNT : NULL);
+    }
+}
+
+// Adds the bits of 'x' to the bit-sliced counters of the lanes
+void vert_add(uint64_t *cnt, uint64_t x)
+{
+    for (size_t k = 0; x; k++)
+    {
+        uint64_t c = cnt[k] & x;
+        cnt[k] ^= x;
+        x = c;
+    }
+}
+
+// Adds the words of the samples selected by the bits of 'sel' 
+static void vert_add_sel(uint64_t *cnt, const uint64_t *perm_bits, size_t sel)
+{
+    for (; sel; sel &= sel - 1) vert_add(cnt, perm_bits[size_bit_scan_forward(sel)]);
+}
+
+// Moves the bits of the byte to the lowest bits of the bytes of the result
+static uint64_t byte_spread(uint64_t x)
+{
+    x = (x | x << 28) & 0x0000000f0000000full;
+    x = (x | x << 14) & 0x0003000300030003ull;
+    return (x | x << 7) & 0x0101010101010101ull;
+}
+
+// Transposes the bit-sliced counters. Every plane is spread to the bytes of the accumulators, thus eight lanes are processed at once
+void vert_get(uint32_t *res, const uint64_t *cnt, size_t bits, size_t lane_cnt)
+{
+    uint64_t acc[MAVER_ADJ_BLK / CHAR_BIT][sizeof(*res)] = { { 0 } };
+    for (size_t k = 0; k < bits; k++) for (size_t q = 0; q < MAVER_ADJ_BLK / CHAR_BIT; q++) 
+        acc[q][k / CHAR_BIT] |= byte_spread((cnt[k] >> (q * CHAR_BIT)) & UINT8_MAX) << (k % CHAR_BIT);
+    size_t len = (bits + CHAR_BIT - 1) / CHAR_BIT;
+    for (size_t r = 0; r < lane_cnt; r++)
+    {
+        uint32_t val = 0;
+        for (size_t m = 0; m < len; m++) val |= (uint32_t) ((acc[r / CHAR_BIT][m] >> (r % CHAR_BIT * CHAR_BIT)) & UINT8_MAX) << (m * CHAR_BIT);
+        res[r] = val;
+    }
+}
+
+// Transposes the 64 x 64 bit matrix in place: bit 'j' of the word 'i' is swapped with bit 'i' of the word 'j'
+void bits_transpose(uint64_t *a)
+{
+    uint64_t m = 0x00000000ffffffffull;
+    for (size_t j = 32; j; j >>= 1, m ^= m << j) for (size_t k = 0; k < 64; k = ((k | j) + 1) & ~j)
+    {
+        uint64_t t = ((a[k] >> j) ^ a[k | j]) & m;
+        a[k] ^= t << j;
+        a[k | j] ^= t;
+    }
+}
+
+// Rows of the transposed matrix of the block are the masks of the first class for the permutations
+void perm_mask_init(size_t *perm_mask, const uint64_t *perm_bits, size_t phen_cnt, size_t rpl_cnt)
+{
+    size_t wcnt = TYPE_CNT(phen_cnt, SIZE_BIT);
+    uint64_t tmp[MAVER_ADJ_BLK];
+    for (size_t j = 0; j < wcnt; j++)
+    {
+        memcpy(tmp, perm_bits + j * SIZE_BIT, sizeof(tmp));
+        bits_transpose(tmp);
+        for (size_t r = 0; r < rpl_cnt; r++) perm_mask[r * wcnt + j] = (size_t) tmp[r];
+    }
+}
+
+// Most common genotype
+static size_t gen_tot_ref(const uint32_t *gen_tot)
+{
+    return gen_tot[1] > gen_tot[0] ? gen_tot[2] > gen_tot[1] ? 2 : 1 : gen_tot[2] > gen_tot[0] ? 2 : 0;
+}
+
+// Builds the 2 x 3 tables of the SNP for the block of the case/control permutations. The table of the replicate 'r' is stored at 'table + r * 2 * GEN_CNT'.
+// If 'vert' is set, only the samples without the most common genotype are visited, and their words of 'perm_bits' are summed by the vertical counters. 
+// The count for the most common genotype is obtained by subtraction, since 'phen_cnt0', the count of the first class, is invariant. Otherwise, the rows 
+// are counted by 'contingency_table_pop_cnt' using the masks obtained by 'perm_mask_init'. Argument 'cnt' is the count of samples without missing calls
+void contingency_table_blk(uint32_t *table, size_t *gen, const uint64_t *perm_bits, size_t *perm_mask, uint32_t *gen_tot, size_t phen_cnt, size_t phen_cnt0, size_t cnt, size_t rpl_cnt, bool vert)
+{
+    size_t wcnt = TYPE_CNT(phen_cnt, SIZE_BIT);
+    if (!vert)
+    {
+        for (size_t r = 0; r < rpl_cnt; r++) contingency_table_pop_cnt(table + r * 2 * GEN_CNT, gen, perm_mask + r * wcnt, gen_tot, phen_cnt, 2);
+        return;
+    }
+
+    // Counters of the first class for the genotypes and for the missing calls. Width of the counter is determined by the total count
+    uint32_t t[GEN_CNT + 1][MAVER_ADJ_BLK];
+    uint64_t vert_cnt[GEN_CNT + 1][sizeof(uint32_t) * CHAR_BIT];
+    size_t vert_bits[GEN_CNT + 1], ref = gen_tot_ref(gen_tot);
+    for (size_t g = 0; g < GEN_CNT + 1; g++)
+    {
+        size_t tot = g < GEN_CNT ? gen_tot[g] : phen_cnt - cnt;
+        vert_bits[g] = g == ref || !tot ? 0 : size_bit_scan_reverse(tot) + 1;
+        memset(vert_cnt[g], 0, vert_bits[g] * sizeof(*vert_cnt[g]));
+    }
+    for (size_t j = 0; j < wcnt; j++)
+    {
+        size_t lo = gen[j << 1], hi = gen[(j << 1) + 1], lim = MIN(phen_cnt - j * SIZE_BIT, SIZE_BIT), msk = lim < SIZE_BIT ? ((size_t) 1 << lim) - 1 : SIZE_MAX;
+        size_t sel[] = { ~(lo | hi) & msk, lo & ~hi & msk, ~lo & hi & msk, lo & hi & msk };
+        for (size_t g = 0; g < GEN_CNT + 1; g++) if (vert_bits[g]) vert_add_sel(vert_cnt[g], perm_bits + j * SIZE_BIT, sel[g]);
+    }
+    for (size_t g = 0; g < GEN_CNT + 1; g++) vert_get(t[g], vert_cnt[g], vert_bits[g], rpl_cnt);
+    for (size_t r = 0; r < rpl_cnt; r++, table += 2 * GEN_CNT)
+    {
+        uint32_t val = (uint32_t) phen_cnt0 - t[GEN_CNT][r];
+        for (size_t g = 0; g < GEN_CNT; g++) if (g != ref) val -= t[g][r];
+        for (size_t g = 0; g < GEN_CNT; g++)
+        {
+            table[g] = g == ref ? val : t[g][r];
+            table[GEN_CNT + g] = gen_tot[g] - table[g];
+        }
+    }
+}
+
+// Vertical counters are used for the SNP if the samples without the most common genotype make up at most this fraction of all samples.
+// Otherwise, the rows of the permutations are counted by 'contingency_table_pop_cnt'
+#define MAVER_ADJ_VERT_DIV 4
+
+// Case/control phenotypes: the block of permutations is evaluated in a single pass over the SNPs. Permutations are bit-sliced, i.e. the word of 
+// the sample holds its class for all permutations of the block. Vertical counters are used for the SNPs with the rare genotypes. For the rest 
+// of the SNPs, the matrix of the permutations is transposed once per block. Permutations are generated in the same order as by 'maver_adj_perm_impl'
+static void maver_adj_rpl_blk(struct maver_adj_context *context, struct maver_adj_thread_supp *thread_supp, size_t rpl_cnt, bool *alt_rpl, double (*density_perm)[ALT_CNT], size_t (*density_perm_cnt)[ALT_CNT])
+{
+    struct categorical_snp_data *snp_data = context->supp->snp_data;
+    uint64_t *perm_bits = thread_supp->perm_bits;
+    size_t *perm_mask = thread_supp->perm_mask, phen_cnt = context->phen_cnt, wcnt = TYPE_CNT(phen_cnt, SIZE_BIT), gen_disp = gen_pack_cnt(phen_cnt), bits = size_bit_scan_reverse(phen_cnt) + 1, phen_cnt0 = 0;
+    bool trans = 0;
+    memset(perm_bits, 0, wcnt * SIZE_BIT * sizeof(*perm_bits));
+    for (size_t i = 0; i < phen_cnt; i++) if (!context->phen[i]) phen_cnt0++;
+    for (size_t r = 0; r < rpl_cnt; r++)
+    {
+        memcpy(thread_supp->phen_perm, context->phen, phen_cnt * sizeof(*thread_supp->phen_perm));
+        rng_shuffle(&thread_supp->rng, thread_supp->phen_perm, phen_cnt);
+        for (size_t i = 0; i < phen_cnt; i++) perm_bits[i] |= (uint64_t) !thread_supp->phen_perm[i] << r;
+    }
+    for (size_t i = 0; i < context->snp_cnt; i++)
+    {
+        size_t cnt = snp_data[i].cnt, *gen = context->gen + i * gen_disp;
+        if (!cnt || !snp_data[i].flags_pop_cnt || (cnt == phen_cnt && snp_data[i].phen_pop_cnt < 2)) continue;
+        uint32_t *gen_tot = snp_data[i].gen_tot, tbl[MAVER_ADJ_BLK][2 * GEN_CNT];
+        bool vert = MAVER_ADJ_VERT_DIV * (phen_cnt - gen_tot[gen_tot_ref(gen_tot)]) <= phen_cnt;
+        if (!vert && !trans)
+        {
+            perm_mask_init(perm_mask, perm_bits, phen_cnt, rpl_cnt);
+            trans = 1;
+        }
+        contingency_table_blk(tbl[0], gen, perm_bits, perm_mask, gen_tot, phen_cnt, phen_cnt0, cnt, rpl_cnt, vert);
+        for (size_t r = 0; r < rpl_cnt; r++)
+        {
+            uint32_t *table = thread_supp->table + ALT_CNT * GEN_CNT * 2;
+            memcpy(table, tbl[r], sizeof(tbl[r]));
+            memset(thread_supp->phen_bits, 0, UINT8_CNT(2));
+            size_t phen_pop_cnt = phen_bits_init_from_table(thread_supp->phen_bits, table, 2);
+            if (phen_pop_cnt < 2) continue;
+            thread_supp->rpl_alt(snp_data + i, context->supp->lut.val, thread_supp, phen_cnt, 2, phen_pop_cnt, bits, alt_rpl, density_perm[r], density_perm_cnt[r], NULL);
+        }
+    }
+}
+
+// Maximal statistics for a single permutation. Alternative is finished as soon as its observed maximum is exceeded, since the replicate is already counted.
+// The SNPs which are the most likely to exceed are visited first
+static void maver_adj_rpl_max(struct maver_adj_context *context, struct maver_adj_thread_supp *thread_supp, bool *alt_rpl, double *density_perm)
+{
+    struct maver_adj_supp *supp = context->supp;
+    size_t gen_disp = gen_pack_cnt(context->phen_cnt), act = 0;
+    bool alt[ALT_CNT];
+    for (size_t j = 0; j < ALT_CNT; j++) act += alt[j] = alt_rpl[j], density_perm[j] = -HUGE_VAL;
+    for (size_t i = 0; i < context->snp_cnt && act; i++)
+    {
+        size_t ind = supp->snp_ord[i], cnt[ALT_CNT] = { 0 };
+        double stat[ALT_CNT], sum[ALT_CNT] = { 0. };
+        array_broadcast(stat, ALT_CNT, sizeof(*stat), &(double) { nan(__func__) });
+        maver_adj_rpl_range(supp->snp_data + ind, supp->lut.val, thread_supp, context->gen + ind * gen_disp, 1, context->phen_cnt, context->phen_ucnt, alt, sum, cnt, stat);
+        for (size_t j = 0; j < ALT_CNT; j++) if (alt[j] && stat[j] > density_perm[j])
+        {
+            density_perm[j] = stat[j];
+            if (stat[j] > context->density[j]) alt[j] = 0, act--;
+        }
+    }
+}
+
+// Computes density for a single permutation of phenotypes. In the moving window and the kernel modes the statistic is derived from the single vector of statistics of the SNPs
+static void maver_adj_rpl_impl(struct maver_adj_context *context, struct maver_adj_thread_supp *thread_supp, bool *alt_rpl, double *density_perm, size_t *density_perm_cnt)
+{
+    maver_adj_perm_impl(thread_supp, context->phen, context->phen_cnt, context->phen_ucnt);
+    if (context->par.type == MAVER_ADJ_TYPE_MEAN)
+    {
+        maver_adj_rpl_range(context->supp->snp_data, context->supp->lut.val, thread_supp, context->gen, context->snp_cnt, context->phen_cnt, context->phen_ucnt, alt_rpl, density_perm, density_perm_cnt, NULL);
+        return;
+    }
+    if (context->par.type == MAVER_ADJ_TYPE_MAX)
+    {
+        maver_adj_rpl_max(context, thread_supp, alt_rpl, density_perm);
+        for (size_t i = 0; i < ALT_CNT; density_perm_cnt[i++] = 1);
+        return;
+    }
+    maver_adj_snp_stat_reset(context, thread_supp->snp_stat);
+    maver_adj_rpl_range(context->supp->snp_data, context->supp->lut.val, thread_supp, context->gen, context->snp_cnt, context->phen_cnt, context->phen_ucnt, alt_rpl, density_perm, density_perm_cnt, thread_supp->snp_stat);
+    maver_adj_reduce(context, density_perm, density_perm_cnt, thread_supp->snp_stat, alt_rpl);
+}
+
+// Keeps the 'cap' largest values in the min-heap
+static void maver_adj_tail_push(double *heap, size_t *p_cnt, size_t cap, double val)
+{
+    size_t i = *p_cnt;
+    if (isnan(val)) return;
+    if (i < cap)
+    {
+        for (; i && heap[(i - 1) / 2] > val; i = (i - 1) / 2) heap[i] = heap[(i - 1) / 2];
+        heap[i] = val;
+        ++*p_cnt;
+        return;
+    }
+    if (!(val > heap[0])) return;
+    i = 0;
+    for (size_t j = 1; j < cap; i = j, j = 2 * j + 1)
+    {
+        if (j + 1 < cap && heap[j + 1] < heap[j]) j++;
+        if (!(heap[j] < val)) break;
+        heap[i] = heap[j];
+    }
+    heap[i] = val;
+}
+
+// Tests if the sufficient number of exceedances is reached for the alternative, provided that the block is the next one to be reduced
+static bool maver_adj_blk_test(struct maver_adj_context *context, size_t blk, size_t alt, size_t cnt, bool mt)
+{
+    if (!mt) return context->qc[alt] + cnt >= context->k;
+    spinlock_acquire(&context->spinlock);
+    bool res = context->blk_red == blk && context->qc[alt] + cnt >= context->k;
+    spinlock_release(&context->spinlock);
+    return res;
+}
+
+// Performs simulations for a single block of replicates. Exceedance bits are stored to 'mask'
+static void maver_adj_blk_impl(struct maver_adj_context *context, struct maver_adj_thread_supp *thread_supp, size_t blk, uint64_t *mask, bool mt)
+{
+    rng_init(&thread_supp->rng, seed_mix(context->seed, blk));
+    float *null = context->supp->null;
+    size_t tail = context->supp->tail, off = blk * MAVER_ADJ_BLK, cnt = MIN(context->rpl - off, MAVER_ADJ_BLK), qc[ALT_CNT] = { 0 };
+    uint8_t stop = uint8_load_acquire(&context->stop);
+    memset(mask, 0, ALT_CNT * sizeof(*mask));
+    double density_perm[MAVER_ADJ_BLK][ALT_CNT] = { { 0. } };
+    size_t density_perm_cnt[MAVER_ADJ_BLK][ALT_CNT] = { { 0 } };
+    bool alt_rpl[ALT_CNT];
+
+    // Statistics of the whole block are computed in advance in the case/control mode. Replicates past the stopping point are then computed in vain, 
+    // but they are not counted below
+    bool pre = thread_supp->perm_bits && context->par.type == MAVER_ADJ_TYPE_MEAN;
+    if (pre && stop != ALT_ALL)
+    {
+        for (size_t i = 0; i < ALT_CNT; i++) alt_rpl[i] = !(stop & (1 << i));
+        maver_adj_rpl_blk(context, thread_supp, cnt, alt_rpl, density_perm, density_perm_cnt);
+    }
+    for (size_t r = 0; r < cnt; r++)
+    {
+        stop |= uint8_load_acquire(&context->stop);
+        if (stop == ALT_ALL) break;
+        for (size_t i = 0; i < ALT_CNT; i++) alt_rpl[i] = !(stop & (1 << i));
+        if (!pre) maver_adj_rpl_impl(context, thread_supp, alt_rpl, density_perm[r], density_perm_cnt[r]);
+
         for (size_t i = 0; i < ALT_CNT; i++) if (alt_rpl[i])
         {
-            if (density_perm[i] > density[i] * (double) density_perm_cnt[i]) qc[i]++;
-            qt[i]++;
+            double x = density_perm[r][i];
+            size_t y = density_perm_cnt[r][i];
+            if (null) null[i * context->rpl + off + r] = y ? (float) (x / (double) y) : (float) nan(__func__);
+            if (tail && y) maver_adj_tail_push(thread_supp->tail + i * (tail + 1), thread_supp->tail_cnt + i, tail + 1, x / (double) y);
+            if (!(x > context->density[i] * (double) y)) continue;
+            mask[i] |= (uint64_t) 1 << r;
+            if (context->k && maver_adj_blk_test(context, blk, i, ++qc[i], mt)) stop |= 1 << i; // Adaptive mode for positive parameter 'k'
+        }
+    }
+}
+
+// Accumulates results of the block. Should be called for the blocks in the ascending order only
+static void maver_adj_red_impl(struct maver_adj_context *context, size_t blk, uint64_t *mask)
+{
+    size_t cnt = MIN(context->rpl - blk * MAVER_ADJ_BLK, MAVER_ADJ_BLK);
+    uint8_t stop = context->stop;
+    for (size_t i = 0; i < ALT_CNT; i++) if (!(stop & (1 << i)))
+    {
+        for (size_t r = 0; r < cnt; r++)
+        {
+            context->qt[i]++;
+            if (!(mask[i] & ((uint64_t) 1 << r)) || ++context->qc[i] != context->k) continue;
+            bit_set_interlocked(&context->stop, i);
+            break;
         }
     }
+}
+
+// Continues the simulations from the saved state. The state is ignored if the generator does not match the seed
+static void maver_adj_ckpt_load(struct maver_adj_context *context)
+{
+    const struct maver_adj_ckpt *init = context->ckpt ? context->ckpt->init : NULL;
+    if (!init || init->blk > context->blk_cnt) return;
+    struct rng rng;
+    rng_init(&rng, seed_mix(context->seed, (size_t) init->blk));
+    if (memcmp(&rng, &init->rng, sizeof(rng))) return;
+    for (size_t i = 0; i < ALT_CNT; i++) context->qc[i] = (size_t) init->qc[i], context->qt[i] = (size_t) init->qt[i];
+    context->stop |= init->stop;
+    context->blk_next = context->blk_red = (size_t) init->blk;
+}
+
+// Takes the state of the simulations after the reduction of all blocks preceding 'blk_red'. Should be called under the lock in the multi-threaded mode
+static void maver_adj_ckpt_get(struct maver_adj_context *context, struct maver_adj_ckpt *ckpt)
+{
+    *ckpt = (struct maver_adj_ckpt) { .blk = context->blk_red, .stop = context->stop };
+    rng_init(&ckpt->rng, seed_mix(context->seed, context->blk_red));
+    for (size_t i = 0; i < ALT_CNT; i++) ckpt->qc[i] = context->qc[i], ckpt->qt[i] = context->qt[i];
+}
+
+// The tail approximation is applied if the count of exceedances is less than this value
+#define MAVER_ADJ_TAIL_QC 10
 
+// Logarithm of the survival function of the generalized Pareto distribution 'S(y) = (1 - k y / s)^(1 / k)'
+static double maver_adj_gpd_log_sf(double k, double s, double y)
+{
+    if (fabs(k) < DBL_EPSILON) return -y / s;
+    double a = -k * y / s;
+    return a > -1. ? log1p(a) / k : -HUGE_VAL;
+}
+
+// Approximation of the p-value of 'x' by the generalized Pareto distribution fitted to the 'cnt' largest of 'rpl' permuted statistics 
+// (Knijnenburg et al., 2009). Parameters are estimated by the probability-weighted moments (Hosking & Wallis, 1987), and the confidence 
+// interval is derived by the delta method from the asymptotic covariance of the estimates. Array 'val' contains at least 'cnt + 1'
+// largest statistics sorted in the ascending order. Returns zero if the approximation is not applicable
+static bool maver_adj_tail_impl(double *p_p, double *p_lo, double *p_hi, const double *val, size_t cnt, size_t rpl, double x)
+{
+    double thr = .5 * (val[0] + val[1]), y = x - thr, n = (double) cnt, a0 = 0., a1 = 0.;
+    if (!(y > 0.)) return 0;
+    for (size_t i = 0; i < cnt; i++)
+    {
+        double z = val[i + 1] - thr;
+        a0 += z;
+        a1 += (1. - ((double) i + .65) / n) * z;
+    }
+    a0 /= n;
+    a1 /= n;
+    double den = a0 - 2. * a1;
+    if (!(den > 0.)) return 0;
+    double k = a0 / den - 2., s = 2. * a0 * a1 / den, log_sf = maver_adj_gpd_log_sf(k, s, y);
+    if (!(s > 0.) || !isfinite(log_sf)) return 0;
+    double p = n / (double) rpl, log_p = log(p) + log_sf;
+    *p_p = exp(log_p);
+    if (!(k < .5))
+    {
+        *p_lo = *p_hi = nan(__func__);
+        return 1;
+    }
+    
+    // Partial derivatives of 'log(S(y))' are computed numerically
+    double hk = 1.e-6 * MAX(fabs(k), 1.), hs = 1.e-6 * s;
+    double dk = (maver_adj_gpd_log_sf(k + hk, s, y) - maver_adj_gpd_log_sf(k - hk, s, y)) / (2. * hk);
+    double ds = (maver_adj_gpd_log_sf(k, s + hs, y) - maver_adj_gpd_log_sf(k, s - hs, y)) / (2. * hs);
+    double c = n * (1. - 2. * k) * (3. - 2. * k);
+    double var_k = (1. - k) * (2. - k) * (2. - k) * (1. - k + 2. * k * k) / c;
+    double var_s = s * s * (7. - 18. * k + 11. * k * k - 2. * k * k * k) / c;
+    double cov = s * (2. - k) * (2. - 6. * k + 7. * k * k - 2. * k * k * k) / c;
+    double var = dk * dk * var_k + ds * ds * var_s + 2. * dk * ds * cov + (1. - p) / n, rad = MAVER_ADJ_Z * sqrt(var);
+    if (!isfinite(rad)) *p_lo = *p_hi = nan(__func__);
+    else
+    {
+        *p_lo = exp(log_p - rad);
+        *p_hi = MIN(exp(log_p + rad), 1.);
+    }
+    return 1;
+}
+
+static bool maver_adj_tail_cmp(const void *A, const void *B, void *Context)
+{
+    (void) Context;
+    return *(const double *) A > *(const double *) B;
+}
+
+// Heaps of all threads are merged. The approximation is applied only to the alternatives which are not stopped by the rule of 'k' exceedances. 
+// Heaps then contain the statistics of exactly the replicates counted by the reduction, while the replicates past the stopping point 
+// are pushed only for the stopped alternatives
+static bool maver_adj_tail_res(struct maver_adj_context *context, struct maver_adj_res *res, size_t alt)
+{
+    struct maver_adj_supp *supp = context->supp;
+    size_t tail = supp->tail, cnt = 0;
+    if (!tail || (context->stop & (1 << alt)) || context->qc[alt] >= MAVER_ADJ_TAIL_QC || context->qt[alt] <= tail) return 0;
+    for (size_t i = 0; i < supp->thread_cnt; i++)
+    {
+        struct maver_adj_thread_supp *thread_supp = supp->thread_supp + i;
+        memcpy(supp->tail_buff + cnt, thread_supp->tail + alt * (tail + 1), thread_supp->tail_cnt[alt] * sizeof(*supp->tail_buff));
+        cnt += thread_supp->tail_cnt[alt];
+    }
+    if (cnt <= tail) return 0;
+    quick_sort(supp->tail_buff, cnt, sizeof(*supp->tail_buff), maver_adj_tail_cmp, NULL);
+    return maver_adj_tail_impl(res->nlpv + alt, res->ci_lo + alt, res->ci_hi + alt, supp->tail_buff + cnt - tail - 1, tail, context->qt[alt], context->density[alt]);
+}
+
+static struct maver_adj_res maver_adj_res_impl(struct maver_adj_context *context, bool *alt)
+{
     struct maver_adj_res res;
     for (size_t i = 0; i < ALT_CNT; i++)
     {
+        res.tail[i] = 0;
         if (alt[i])
         {
-            res.nlpv[i] = (double) qc[i] / (double) qt[i];//log10((double) qt[i]) - log10((double) qc[i]);
-            res.rpl[i] = qt[i];
+            res.rpl[i] = context->qt[i];
+            if ((res.tail[i] = maver_adj_tail_res(context, &res, i))) continue;
+            res.nlpv[i] = (double) context->qc[i] / (double) context->qt[i];//log10((double) qt[i]) - log10((double) qc[i]);
+            maver_adj_ci_impl(res.ci_lo + i, res.ci_hi + i, context->qc[i], context->qt[i]);
         }
         else
         {
-            res.nlpv[i] = nan(__func__);
+            res.nlpv[i] = res.ci_lo[i] = res.ci_hi[i] = nan(__func__);
             res.rpl[i] = 0;
         }
     }
     return res;
 }
+
+// P-values are recomputed from the cached permuted statistics of the window. Statistics of each alternative are taken in the order of 
+// the replicates until 'k' exceedances are observed, if 'k' is non-zero, or 'rpl' replicates are taken, if 'rpl' is non-zero
+bool maver_adj_null_res(struct maver_adj_res *res, float *const *val, const size_t *val_cnt, const double *density, size_t rpl, size_t k, size_t tail)
+{
+    double *heap = NULL;
+    if (tail && !array_init(&heap, NULL, tail + 1, sizeof(*heap), 0, ARRAY_STRICT)) return 0;
+    for (size_t i = 0; i < ALT_CNT; i++)
+    {
+        size_t cnt = rpl ? MIN(val_cnt[i], rpl) : val_cnt[i], qc = 0, qt = 0, heap_cnt = 0;
+        res->rpl[i] = res->tail[i] = 0;
+        if (!cnt)
+        {
+            res->nlpv[i] = res->ci_lo[i] = res->ci_hi[i] = nan(__func__);
+            continue;
+        }
+        while (qt < cnt && (!k || qc < k))
+        {
+            double x = (double) val[i][qt++];
+            if (x > density[i]) qc++;
+            if (tail) maver_adj_tail_push(heap, &heap_cnt, tail + 1, x);
+        }
+        res->rpl[i] = qt;
+        if (tail && (!k || qc < k) && qc < MAVER_ADJ_TAIL_QC && heap_cnt > tail)
+        {
+            quick_sort(heap, heap_cnt, sizeof(*heap), maver_adj_tail_cmp, NULL);
+            if ((res->tail[i] = maver_adj_tail_impl(res->nlpv + i, res->ci_lo + i, res->ci_hi + i, heap, tail, qt, density[i]))) continue;
+        }
+        res->nlpv[i] = (double) qc / (double) qt;
+        maver_adj_ci_impl(res->ci_lo + i, res->ci_hi + i, qc, qt);
+    }
+    free(heap);
+    return 1;
+}
+
+struct maver_adj_res maver_adj_impl(struct maver_adj_supp *supp, size_t *gen, size_t *phen, size_t snp_cnt, size_t phen_cnt, size_t phen_ucnt, struct maver_adj_par par, size_t rpl, size_t k, uint64_t seed, struct maver_adj_ckpt_par *ckpt, enum categorical_flags flags)
+{
+    struct maver_adj_context context = { .supp = supp, .gen = gen, .phen = phen, .snp_cnt = snp_cnt, .phen_cnt = phen_cnt, .phen_ucnt = phen_ucnt, .par = par, .ckpt = ckpt, .rpl = rpl, .k = k, .seed = seed };
+    bool alt[ALT_CNT];
+    maver_adj_init_impl(&context, alt, flags);
+    maver_adj_ckpt_load(&context);
+
+    // Simulations
+    while (context.blk_red < context.blk_cnt && context.stop != ALT_ALL)
+    {
+        uint64_t mask[ALT_CNT];
+        maver_adj_blk_impl(&context, supp->thread_supp, context.blk_red, mask, 0);
+        maver_adj_red_impl(&context, context.blk_red++, mask);
+        if (!ckpt || !ckpt->callback) continue;
+        struct maver_adj_ckpt state;
+        maver_adj_ckpt_get(&context, &state);
+        ckpt->callback(&state, ckpt->context);
+    }
+    return maver_adj_res_impl(&context, alt);
+}
+
+static bool maver_adj_thread_proc(void *Context, void *tmp)
+{
+    (void) tmp;
+    struct maver_adj_context *context = Context;
+    struct maver_adj_supp *supp = context->supp;
+    struct maver_adj_thread_supp *thread_supp = supp->thread_supp + thread_pool_get_thread_id(context->pool);
+    for (;;)
+    {
+        // Acquiring the next block
+        spinlock_acquire(&context->spinlock);
+        size_t blk = context->blk_next < context->blk_cnt && context->stop != ALT_ALL ? context->blk_next++ : SIZE_MAX;
+        spinlock_release(&context->spinlock);
+        if (blk == SIZE_MAX) break;
+
+        uint64_t *mask = supp->blk_mask + blk * ALT_CNT;
+        maver_adj_blk_impl(context, thread_supp, blk, mask, 1);
+
+        // Reducing all consecutive blocks which are ready. The state is passed to the callback outside of the lock
+        struct maver_adj_ckpt_par *ckpt = context->ckpt;
+        struct maver_adj_ckpt state;
+        spinlock_acquire(&context->spinlock);
+        uint8_bit_set(supp->blk_bits, blk);
+        size_t blk_red = context->blk_red;
+        for (; context->blk_red < context->blk_cnt && uint8_bit_test(supp->blk_bits, context->blk_red); context->blk_red++)
+            maver_adj_red_impl(context, context->blk_red, supp->blk_mask + context->blk_red * ALT_CNT);
+        bool red = ckpt && ckpt->callback && context->blk_red != blk_red;
+        if (red) maver_adj_ckpt_get(context, &state);
+        spinlock_release(&context->spinlock);
+        if (red) ckpt->callback(&state, ckpt->context);
+    }
+
+    mutex_acquire(&supp->mutex);
+    if (!--context->pend) condition_broadcast(&supp->condition);
+    mutex_release(&supp->mutex);
+    return 1;
+}
+
+struct maver_adj_res maver_adj_impl_mt(struct maver_adj_supp *supp, struct thread_pool *pool, size_t *gen, size_t *phen, size_t snp_cnt, size_t phen_cnt, size_t phen_ucnt, struct maver_adj_par par, size_t rpl, size_t k, uint64_t seed, struct maver_adj_ckpt_par *ckpt, enum categorical_flags flags)
+{
+    size_t thread_cnt = pool ? thread_pool_get_count(pool) : 0;
+    if (!supp->tasks || thread_cnt > supp->thread_cnt) return maver_adj_impl(supp, gen, phen, snp_cnt, phen_cnt, phen_ucnt, par, rpl, k, seed, ckpt, flags);
+
+    struct maver_adj_context context = { .supp = supp, .pool = pool, .gen = gen, .phen = phen, .snp_cnt = snp_cnt, .phen_cnt = phen_cnt, .phen_ucnt = phen_ucnt, .par = par, .ckpt = ckpt, .rpl = rpl, .k = k, .seed = seed, .spinlock = SPINLOCK_INIT, .pend = thread_cnt };
+    bool alt[ALT_CNT];
+    maver_adj_init_impl(&context, alt, flags);
+    maver_adj_ckpt_load(&context);
+    memset(supp->blk_bits, 0, UINT8_CNT(context.blk_cnt) * sizeof(*supp->blk_bits));
+
+    // Simulations
+    for (size_t i = 0; i < thread_cnt; i++) supp->tasks[i] = (struct task) { .callback = maver_adj_thread_proc, .arg = &context };
+    if (!thread_pool_enqueue_tasks(pool, supp->tasks, thread_cnt, 1)) return maver_adj_impl(supp, gen, phen, snp_cnt, phen_cnt, phen_ucnt, par, rpl, k, seed, ckpt, flags);
+    mutex_acquire(&supp->mutex);
+    while (context.pend) condition_sleep(&supp->condition, &supp->mutex);
+    mutex_release(&supp->mutex);
+    return maver_adj_res_impl(&context, alt);
+}
+
+// Blocks of replicates in a single round of the joint mode per thread
+#define MAVER_ADJ_JOINT_RND 2
+
+// Overlapping and adjacent windows are merged into the segments. Windows are mapped to the concatenation of the segments
+static bool maver_adj_joint_union_init(struct maver_adj_joint_supp *supp, struct maver_adj_wnd *wnd, size_t wnd_cnt)
+{
+    uintptr_t *ord = orders_stable(wnd, wnd_cnt, sizeof(*wnd), size_stable_cmp_asc, NULL);
+    if (wnd_cnt && !ord) return 0;
+    size_t end = 0;
+    for (size_t i = 0; i < wnd_cnt; i++)
+    {
+        size_t w = ord[i], off = wnd[w].off;
+        if (!supp->seg_cnt || off > end)
+        {
+            if (supp->seg_cnt) supp->snp_cnt += supp->seg[supp->seg_cnt - 1].cnt;
+            supp->seg_off[supp->seg_cnt] = supp->snp_cnt;
+            supp->seg[supp->seg_cnt++] = (struct maver_adj_wnd) { .off = off };
+            end = off;
+        }
+        struct maver_adj_wnd *seg = supp->seg + supp->seg_cnt - 1;
+        end = MAX(end, off + wnd[w].cnt);
+        seg->cnt = end - seg->off;
+        supp->wnd_seg[w] = supp->seg_cnt - 1;
+        supp->wnd[w] = (struct maver_adj_wnd) { .off = supp->seg_off[supp->seg_cnt - 1] + off - seg->off, .cnt = wnd[w].cnt };
+    }
+    if (supp->seg_cnt) supp->snp_cnt += supp->seg[supp->seg_cnt - 1].cnt;
+    free(ord);
+    return 1;
+}
+
+bool maver_adj_joint_init(struct maver_adj_joint_supp *supp, struct maver_adj_wnd *wnd, size_t wnd_cnt, size_t phen_cnt, size_t phen_ucnt, size_t thread_cnt)
+{
+    *supp = (struct maver_adj_joint_supp) { .slot_cnt = thread_cnt > 1 ? thread_cnt * MAVER_ADJ_JOINT_RND : 1, .wnd_cnt = wnd_cnt };
+    if (phen_ucnt > phen_cnt || phen_cnt > CATEGORICAL_CNT_MAX || !thread_cnt) return 0; // Wrong parameter
+
+    if (array_init(&supp->seg, NULL, wnd_cnt, sizeof(*supp->seg), 0, ARRAY_STRICT) &&
+        array_init(&supp->wnd, NULL, wnd_cnt, sizeof(*supp->wnd), 0, ARRAY_STRICT) &&
+        array_init(&supp->seg_off, NULL, wnd_cnt, sizeof(*supp->seg_off), 0, ARRAY_STRICT) &&
+        array_init(&supp->wnd_seg, NULL, wnd_cnt, sizeof(*supp->wnd_seg), 0, ARRAY_STRICT) &&
+        maver_adj_joint_union_init(supp, wnd, wnd_cnt) &&
+        array_init(&supp->snp_data, NULL, supp->snp_cnt, sizeof(*supp->snp_data), 0, ARRAY_STRICT) &&
+        array_init(&supp->psum, NULL, thread_cnt * supp->snp_cnt, ALT_CNT * sizeof(*supp->psum), 0, ARRAY_STRICT) &&
+        array_init(&supp->pcnt, NULL, thread_cnt * supp->snp_cnt, ALT_CNT * sizeof(*supp->pcnt), 0, ARRAY_STRICT) &&
+        array_init(&supp->seg_alt, NULL, thread_cnt, supp->seg_cnt * sizeof(*supp->seg_alt), 0, ARRAY_STRICT) &&
+        array_init(&supp->density, NULL, wnd_cnt, ALT_CNT * sizeof(*supp->density), 0, ARRAY_STRICT) &&
+        array_init(&supp->qc, NULL, wnd_cnt, ALT_CNT * sizeof(*supp->qc), 0, ARRAY_STRICT) &&
+        array_init(&supp->qt, NULL, wnd_cnt, ALT_CNT * sizeof(*supp->qt), 0, ARRAY_STRICT) &&
+        array_init(&supp->stop, NULL, wnd_cnt, sizeof(*supp->stop), 0, ARRAY_STRICT) &&
+        array_init(&supp->blk_mask, NULL, supp->slot_cnt * wnd_cnt, ALT_CNT * sizeof(*supp->blk_mask), 0, ARRAY_STRICT) &&
+        array_init(&supp->thread_supp, NULL, thread_cnt, sizeof(*supp->thread_supp), 0, ARRAY_STRICT))
+    {
+        for (; supp->thread_cnt < thread_cnt && maver_adj_thread_init(supp->thread_supp + supp->thread_cnt, phen_cnt, phen_ucnt) &&
+            array_init(&supp->thread_supp[supp->thread_cnt].snp_stat, NULL, supp->snp_cnt, ALT_CNT * sizeof(*supp->thread_supp->snp_stat), 0, ARRAY_STRICT); supp->thread_cnt++)
+            supp->thread_supp[supp->thread_cnt].rpl_alt = maver_adj_alt_select(phen_ucnt);
+        if (supp->thread_cnt == thread_cnt)
+        {
+            if (thread_cnt == 1) return 1;
+            if (mutex_init(&supp->mutex))
+            {
+                if (condition_init(&supp->condition))
+                {
+                    if (array_init(&supp->tasks, NULL, thread_cnt, sizeof(*supp->tasks), 0, ARRAY_STRICT)) return 1;
+                    condition_close(&supp->condition);
+                }
+                mutex_close(&supp->mutex);
+            }
+        }
+    }
+    maver_adj_joint_close(supp);
+    return 0;
+}
+
+void maver_adj_joint_close(struct maver_adj_joint_supp *supp)
+{
+    if (supp->tasks)
+    {
+        condition_close(&supp->condition);
+        mutex_close(&supp->mutex);
+        free(supp->tasks);
+    }
+    for (size_t i = 0; i < supp->thread_cnt; maver_adj_thread_close(supp->thread_supp + i++));
+    free(supp->thread_supp);
+    free(supp->snp_data);
+    free(supp->lut.val);
+    free(supp->seg);
+    free(supp->wnd);
+    free(supp->seg_off);
+    free(supp->wnd_seg);
+    free(supp->psum);
+    free(supp->pcnt);
+    free(supp->seg_alt);
+    free(supp->density);
+    free(supp->qc);
+    free(supp->qt);
+    free(supp->stop);
+    free(supp->blk_mask);
+}
+
+struct maver_adj_joint_context {
+    struct maver_adj_joint_supp *supp;
+    struct thread_pool *pool;
+    size_t *gen, *phen, phen_cnt, phen_ucnt, rpl, k;
+    uint64_t seed;
+    // Fields below are shared between the threads
+    spinlock_handle spinlock;
+    size_t blk_next, blk_end, pend;
+};
+
+// Inclusive prefix sums and counts of the statistics of the segment. Missing statistics are NaN's
+static void maver_adj_joint_psum(double *psum, uint32_t *pcnt, const double *snp_stat, size_t cnt)
+{
+    double sum[ALT_CNT] = { 0. };
+    uint32_t sum_cnt[ALT_CNT] = { 0 };
+    for (size_t i = 0; i < cnt; i++) for (size_t j = 0; j < ALT_CNT; j++)
+    {
+        double x = snp_stat[i * ALT_CNT + j];
+        if (!isnan(x)) sum[j] += x, sum_cnt[j]++;
+        psum[i * ALT_CNT + j] = sum[j];
+        pcnt[i * ALT_CNT + j] = sum_cnt[j];
+    }
+}
+
+// Computes statistics of the segment and their prefix sums
+static void maver_adj_joint_seg_impl(struct maver_adj_joint_supp *supp, struct maver_adj_thread_supp *thread_supp, double *psum, uint32_t *pcnt, size_t seg, size_t *gen, size_t phen_cnt, size_t phen_ucnt, bool *alt_rpl)
+{
+    size_t off = supp->seg_off[seg], cnt = supp->seg[seg].cnt, density_cnt[ALT_CNT] = { 0 };
+    double density[ALT_CNT] = { 0. }, *snp_stat = thread_supp->snp_stat + off * ALT_CNT;
+    array_broadcast(snp_stat, cnt * ALT_CNT, sizeof(*snp_stat), &(double) { nan(__func__) });
+    maver_adj_rpl_range(supp->snp_data + off, supp->lut.val, thread_supp, gen + supp->seg[seg].off * gen_pack_cnt(phen_cnt), cnt, phen_cnt, phen_ucnt, alt_rpl, density, density_cnt, snp_stat);
+    maver_adj_joint_psum(psum + off * ALT_CNT, pcnt + off * ALT_CNT, snp_stat, cnt);
+}
+
+// Sum and count of the statistics of the window are derived from the prefix sums of its segment
+static void maver_adj_joint_wnd_impl(struct maver_adj_joint_supp *supp, const double *psum, const uint32_t *pcnt, size_t w, double *density, size_t *density_cnt)
+{
+    size_t off = supp->wnd[w].off, last = (off + supp->wnd[w].cnt - 1) * ALT_CNT;
+    bool head = off == supp->seg_off[supp->wnd_seg[w]];
+    for (size_t i = 0; i < ALT_CNT; i++)
+    {
+        density[i] = head ? psum[last + i] : psum[last + i] - psum[(off - 1) * ALT_CNT + i];
+        density_cnt[i] = head ? pcnt[last + i] : pcnt[last + i] - pcnt[(off - 1) * ALT_CNT + i];
+    }
+}
+
+// Tests if the alternatives of the window should be simulated. Alternative is skipped if it is finished before the round, 
+// or if the sufficient number of exceedances is reached within the block
+static uint8_t maver_adj_joint_alt(struct maver_adj_joint_context *context, uint64_t *wnd_mask, size_t w)
+{
+    struct maver_adj_joint_supp *supp = context->supp;
+    size_t *qc = supp->qc + w * ALT_CNT;
+    uint8_t res = 0;
+    for (size_t i = 0; i < ALT_CNT; i++)
+        if (!(supp->stop[w] & (1 << i)) && !(context->k && qc[i] + size_pop_cnt((size_t) wnd_mask[i]) >= context->k)) res |= 1 << i;
+    return res;
+}
+
+// Performs simulations for a single block of replicates. Every permutation is applied to all windows, which are not finished yet.
+// Statistics of the SNPs are computed once per permutation for the segments containing the active windows
+static void maver_adj_joint_blk_impl(struct maver_adj_joint_context *context, struct maver_adj_thread_supp *thread_supp, size_t blk)
+{
+    struct maver_adj_joint_supp *supp = context->supp;
+    size_t off = blk * MAVER_ADJ_BLK, cnt = MIN(context->rpl - off, MAVER_ADJ_BLK), wnd_cnt = supp->wnd_cnt, tid = (size_t) (thread_supp - supp->thread_supp);
+    double *psum = supp->psum + tid * supp->snp_cnt * ALT_CNT;
+    uint32_t *pcnt = supp->pcnt + tid * supp->snp_cnt * ALT_CNT;
+    uint8_t *seg_alt = supp->seg_alt + tid * supp->seg_cnt;
+    uint64_t *mask = supp->blk_mask + (blk % supp->slot_cnt) * wnd_cnt * ALT_CNT;
+    memset(mask, 0, wnd_cnt * ALT_CNT * sizeof(*mask));
+    rng_init(&thread_supp->rng, seed_mix(context->seed, blk));
+    for (size_t r = 0; r < cnt; r++)
+    {
+        bool act = 0;
+        maver_adj_perm_impl(thread_supp, context->phen, context->phen_cnt, context->phen_ucnt);
+        memset(seg_alt, 0, supp->seg_cnt * sizeof(*seg_alt));
+        for (size_t w = 0; w < wnd_cnt; w++)
+        {
+            uint8_t alt = maver_adj_joint_alt(context, mask + w * ALT_CNT, w);
+            seg_alt[supp->wnd_seg[w]] |= alt;
+            act |= !!alt;
+        }
+        if (!act) break;
+        for (size_t s = 0; s < supp->seg_cnt; s++) if (seg_alt[s])
+        {
+            bool alt_rpl[ALT_CNT];
+            for (size_t i = 0; i < ALT_CNT; i++) alt_rpl[i] = seg_alt[s] & (1 << i);
+            maver_adj_joint_seg_impl(supp, thread_supp, psum, pcnt, s, context->gen, context->phen_cnt, context->phen_ucnt, alt_rpl);
+        }
+        for (size_t w = 0; w < wnd_cnt; w++)
+        {
+            uint64_t *wnd_mask = mask + w * ALT_CNT;
+            uint8_t alt = maver_adj_joint_alt(context, wnd_mask, w);
+            if (!alt) continue;
+            double density_perm[ALT_CNT], *density = supp->density + w * ALT_CNT;
+            size_t density_perm_cnt[ALT_CNT];
+            maver_adj_joint_wnd_impl(supp, psum, pcnt, w, density_perm, density_perm_cnt);
+            for (size_t i = 0; i < ALT_CNT; i++) if ((alt & (1 << i)) && density_perm[i] > density[i] * (double) density_perm_cnt[i]) wnd_mask[i] |= (uint64_t) 1 << r;
+        }
+    }
+}
+
+// Accumulates results of the block. Should be called for the blocks in the ascending order only
+static void maver_adj_joint_red_impl(struct maver_adj_joint_context *context, size_t blk)
+{
+    struct maver_adj_joint_supp *supp = context->supp;
+    size_t cnt = MIN(context->rpl - blk * MAVER_ADJ_BLK, MAVER_ADJ_BLK);
+    uint64_t *mask = supp->blk_mask + (blk % supp->slot_cnt) * supp->wnd_cnt * ALT_CNT;
+    for (size_t w = 0; w < supp->wnd_cnt; w++) for (size_t i = 0; i < ALT_CNT; i++) if (!(supp->stop[w] & (1 << i)))
+    {
+        size_t *qc = supp->qc + w * ALT_CNT + i, *qt = supp->qt + w * ALT_CNT + i;
+        for (size_t r = 0; r < cnt; r++)
+        {
+            ++*qt;
+            if (!(mask[w * ALT_CNT + i] & ((uint64_t) 1 << r)) || ++*qc != context->k) continue;
+            supp->stop[w] |= 1 << i;
+            break;
+        }
+    }
+}
+
+static bool maver_adj_joint_thread_proc(void *Context, void *tmp)
+{
+    (void) tmp;
+    struct maver_adj_joint_context *context = Context;
+    struct maver_adj_joint_supp *supp = context->supp;
+    struct maver_adj_thread_supp *thread_supp = supp->thread_supp + thread_pool_get_thread_id(context->pool);
+    for (;;)
+    {
+        spinlock_acquire(&context->spinlock);
+        size_t blk = context->blk_next < context->blk_end ? context->blk_next++ : SIZE_MAX;
+        spinlock_release(&context->spinlock);
+        if (blk == SIZE_MAX) break;
+        maver_adj_joint_blk_impl(context, thread_supp, blk);
+    }
+
+    mutex_acquire(&supp->mutex);
+    if (!--context->pend) condition_broadcast(&supp->condition);
+    mutex_release(&supp->mutex);
+    return 1;
+}
+
+void maver_adj_joint_impl(struct maver_adj_joint_supp *supp, struct thread_pool *pool, struct maver_adj_res *res, size_t *gen, size_t *phen, size_t phen_cnt, size_t phen_ucnt, size_t rpl, size_t k, uint64_t seed, enum categorical_flags flags)
+{
+    struct maver_adj_joint_context context = { .supp = supp, .pool = pool, .gen = gen, .phen = phen, .phen_cnt = phen_cnt, .phen_ucnt = phen_ucnt, .rpl = rpl, .k = k, .seed = seed, .spinlock = SPINLOCK_INIT };
+    size_t thread_cnt = pool ? thread_pool_get_count(pool) : 0, wnd_cnt = supp->wnd_cnt, gen_disp = gen_pack_cnt(phen_cnt);
+    bool mt = supp->tasks && thread_cnt <= supp->thread_cnt;
+
+    // Observed statistics of the windows are derived from the statistics of the segments
+    if (phen_ucnt <= PHEN_UCNT_POP_CNT_MAX) phen_mask_init(supp->thread_supp->phen_mask, phen, phen_cnt, phen_ucnt);
+    supp->lut.cnt = 0;
+    maver_adj_memo_reset(supp->thread_supp, supp->thread_cnt);
+    memset(supp->qc, 0, wnd_cnt * ALT_CNT * sizeof(*supp->qc));
+    memset(supp->qt, 0, wnd_cnt * ALT_CNT * sizeof(*supp->qt));
+    for (size_t s = 0; s < supp->seg_cnt; s++)
+    {
+        size_t off = supp->seg_off[s], cnt = supp->seg[s].cnt, density_cnt[ALT_CNT] = { 0 };
+        double density[ALT_CNT] = { 0. }, *snp_stat = supp->thread_supp->snp_stat + off * ALT_CNT;
+        array_broadcast(snp_stat, cnt * ALT_CNT, sizeof(*snp_stat), &(double) { nan(__func__) });
+        maver_adj_init_range(supp->snp_data + off, &supp->lut, supp->thread_supp, gen + supp->seg[s].off * gen_disp, phen, cnt, phen_cnt, phen_ucnt, rpl, density, density_cnt, snp_stat, flags);
+        maver_adj_joint_psum(supp->psum + off * ALT_CNT, supp->pcnt + off * ALT_CNT, snp_stat, cnt);
+    }
+    for (size_t w = 0; w < wnd_cnt; w++)
+    {
+        double *density = supp->density + w * ALT_CNT;
+        size_t density_cnt[ALT_CNT];
+        maver_adj_joint_wnd_impl(supp, supp->psum, supp->pcnt, w, density, density_cnt);
+        supp->stop[w] = maver_adj_stop_init(density, density_cnt, flags);
+    }
+
+    // Simulations are performed by rounds. Results of the round are reduced in the order of blocks
+    size_t blk_cnt = rpl / MAVER_ADJ_BLK + !!(rpl % MAVER_ADJ_BLK);
+    for (size_t blk = 0; blk < blk_cnt; blk = context.blk_end)
+    {
+        size_t w = 0;
+        for (; w < wnd_cnt && supp->stop[w] == ALT_ALL; w++);
+        if (w == wnd_cnt) break;
+
+        context.blk_next = blk;
+        context.blk_end = MIN(blk + supp->slot_cnt, blk_cnt);
+        if (mt)
+        {
+            context.pend = thread_cnt;
+            for (size_t i = 0; i < thread_cnt; i++) supp->tasks[i] = (struct task) { .callback = maver_adj_joint_thread_proc, .arg = &context };
+            if (!thread_pool_enqueue_tasks(pool, supp->tasks, thread_cnt, 1)) mt = 0;
+            else
+            {
+                mutex_acquire(&supp->mutex);
+                while (context.pend) condition_sleep(&supp->condition, &supp->mutex);
+                mutex_release(&supp->mutex);
+            }
+        }
+        if (!mt) for (size_t i = blk; i < context.blk_end; maver_adj_joint_blk_impl(&context, supp->thread_supp, i++));
+        for (size_t i = blk; i < context.blk_end; maver_adj_joint_red_impl(&context, i++));
+    }
+
+    for (size_t w = 0; w < wnd_cnt; w++) for (size_t i = 0; i < ALT_CNT; i++)
+    {
+        size_t qc = supp->qc[w * ALT_CNT + i], qt = supp->qt[w * ALT_CNT + i];
+        res[w].nlpv[i] = qt ? (double) qc / (double) qt : nan(__func__);
+        res[w].rpl[i] = qt;
+        res[w].tail[i] = 0;
+        maver_adj_ci_impl(res[w].ci_lo + i, res[w].ci_hi + i, qc, qt);
+    }
+}
@@ -1,10 +1,16 @@
 #pragma once
 
 #include "common.h"
-
-#include <gsl/gsl_rng.h>
+#include "rng.h"
+#include "threadpool.h"
+#include "threadsupp.h"
 
 #define ALT_CNT 4
+#define GEN_CNT 3
+
+// Replicates are processed by blocks of fixed length. Every block has its own random number stream, 
+// which makes the results independent of the count of threads used
+#define MAVER_ADJ_BLK (sizeof(uint64_t) * CHAR_BIT)
 
 enum categorical_flags {
     TEST_TYPE_CODOMINANT = 1,
@@ -13,33 +19,160 @@ enum categorical_flags {
     TEST_TYPE_ALLELIC = 8
 };
 
+struct categorical_supp;
+struct categorical_res;
+
+// Tests for each alternative. Case/control specialization is selected once by 'categorical_init'
+typedef void (*categorical_alt_callback)(struct categorical_res *, struct categorical_supp *, uint8_t *, uint32_t *, size_t, size_t);
+
 struct categorical_supp {
     uint8_t *phen_bits;
-    size_t *filter, *table, *phen_mar, *outer;
+    size_t *filter;
+    uint32_t *table, *phen_mar, *hist;
+    uint64_t *outer;
+    double *log_fact; // Table of 'log(n!)' used by the exact test
+    categorical_alt_callback alt;
 };
 
 struct categorical_res {
     double nlpv[ALT_CNT], qas[ALT_CNT];
 };
 
-struct maver_adj_supp {
+struct categorical_snp_data;
+struct maver_adj_thread_supp;
+
+// Permuted statistics of a single SNP for each alternative. Case/control specialization is selected once per window
+typedef void (*maver_adj_alt_callback)(struct categorical_snp_data *, const double *, struct maver_adj_thread_supp *, size_t, size_t, size_t, size_t, bool *, double *, size_t *, double *);
+
+// Scratch memory of a single worker performing the permutation replicates
+struct maver_adj_thread_supp {
+    struct rng rng;
     uint8_t *phen_bits;
-    size_t *filter, *table, *phen_mar, *phen_perm, *outer;
-    struct categorical_snp_data *snp_data;    
+    size_t *phen_perm, *phen_mask, *filter;
+    uint64_t *perm_bits; // Bit-sliced block of permutations of the case/control phenotypes: bit 'r' of the word of the sample is set if the sample is in the first class in the replicate 'r'
+    size_t *perm_mask; // Masks of the first class for the permutations of the block, obtained by the transposition of 'perm_bits'
+    uint32_t *table, *phen_mar, *hist;
+    uint64_t *outer;
+    double *snp_stat; // Statistics of the SNPs for the current permutation used by the moving window and the kernel modes
+    double *tail; // Min-heaps of the largest permuted statistics for each alternative used by the tail approximation
+    size_t tail_cnt[ALT_CNT];
+    struct maver_adj_memo *memo;
+    maver_adj_alt_callback rpl_alt;
+};
+
+// Lookup tables of the statistic for the SNPs without missing calls
+struct maver_adj_lut {
+    double *val;
+    size_t cap, cnt;
+};
+
+struct maver_adj_supp {
+    struct maver_adj_lut lut;
+    struct categorical_snp_data *snp_data;
+    struct maver_adj_thread_supp *thread_supp;
+    size_t thread_cnt, tail; // Count of the largest permuted statistics used by the tail approximation. Zero disables the approximation
+    double *weight; // Weights of the SNPs in the kernel mode
+    double *tail_buff; // Largest permuted statistics of all threads
+    double density[ALT_CNT]; // Observed statistics of the last window
+    float *null; // Permuted statistics of the replicates for each alternative cached for the recomputation, or NULL if the cache is disabled
+    size_t *snp_ord; // Order of the SNPs in the max mode
+    // Fields below are used only in the multi-threaded mode
+    uint64_t *blk_mask; // Exceedance bits of the replicates for each block and alternative
+    uint8_t *blk_bits; // Bits of the blocks which are ready to be reduced
+    struct task *tasks;
+    mutex_handle mutex;
+    condition_handle condition;
+};
+
+struct maver_adj_wnd {
+    size_t off, cnt;
+};
+
+// Joint mode: every permutation of phenotypes is shared by all windows. Statistics of the SNPs are computed once per permutation 
+// for the union of the windows, which is composed of the segments of the overlapping windows
+struct maver_adj_joint_supp {
+    struct maver_adj_lut lut;
+    struct categorical_snp_data *snp_data; // Data of the SNPs of the union
+    struct maver_adj_thread_supp *thread_supp;
+    struct maver_adj_wnd *seg, *wnd; // Segments in the coordinates of the source, and windows in the coordinates of the union
+    size_t thread_cnt, slot_cnt, seg_cnt, wnd_cnt, snp_cnt, *seg_off, *wnd_seg, *qc, *qt;
+    double *density, *psum; // Prefix sums of the statistics within the segments for each thread
+    uint32_t *pcnt; // Prefix counts of the statistics within the segments for each thread
+    uint8_t *stop; // Bits of the finished alternatives for each window
+    uint8_t *seg_alt; // Bits of the alternatives to be computed for each segment and thread
+    uint64_t *blk_mask; // Exceedance bits of the replicates for each block of the round, window, and alternative
+    struct task *tasks;
+    mutex_handle mutex;
+    condition_handle condition;
+};
+
+// Statistic of the region: mean of the statistics of the SNPs, maximal mean over the moving windows of 'wnd' consecutive SNPs, 
+// the sum of the statistics weighted by the normal kernel with the standard deviation 'sd' centered at the middle of the region,
+// or the maximal statistic of the SNPs
+enum maver_adj_type {
+    MAVER_ADJ_TYPE_MEAN = 0,
+    MAVER_ADJ_TYPE_MOV,
+    MAVER_ADJ_TYPE_KERNEL,
+    MAVER_ADJ_TYPE_MAX
+};
+
+struct maver_adj_par {
+    enum maver_adj_type type;
+    size_t wnd;
+    double sd;
+};
+
+// State of the simulations for a single window at the boundary of the blocks of replicates, which is sufficient to continue them
+struct maver_adj_ckpt {
+    struct rng rng; // State of the generator at the beginning of the block 'blk'
+    uint64_t blk, qc[ALT_CNT], qt[ALT_CNT];
+    uint8_t stop;
+};
+
+typedef void (*maver_adj_ckpt_callback)(const struct maver_adj_ckpt *, void *);
+
+// Simulations are continued from 'init', if it is not NULL and matches the seed. The callback is called every time a block is reduced
+struct maver_adj_ckpt_par {
+    const struct maver_adj_ckpt *init;
+    maver_adj_ckpt_callback callback;
+    void *context;
 };
 
 struct maver_adj_res {
-    double nlpv[ALT_CNT];
+    double nlpv[ALT_CNT], ci_lo[ALT_CNT], ci_hi[ALT_CNT]; // Estimate of the p-value and its 95% confidence interval
     size_t rpl[ALT_CNT];
+    bool tail[ALT_CNT]; // P-value is extrapolated by the tail approximation
 };
 
-double stat_exact(size_t *, size_t *, size_t *);
-double qas_exact(size_t *t);
+// Relative tolerance for the comparison of the hypergeometric probabilities
+#define STAT_EXACT_EPS 1e-7
+
+double stat_exact(uint32_t *, uint32_t *, uint32_t *, const double *);
+double qas_exact(uint32_t *t);
+
+size_t gen_pop_cnt_alt_init(uint32_t *, uint8_t *, enum categorical_flags);
+void contingency_table_alt_init(uint32_t *, uint32_t (*)[GEN_CNT], uint32_t *, uint32_t *, uint8_t *, uint32_t *, uint8_t *, size_t);
+void phen_mask_init(size_t *, size_t *, size_t, size_t);
+void contingency_table_pop_cnt(uint32_t *, size_t *, size_t *, uint32_t *, size_t, size_t);
+
+// Bit-sliced evaluation of the block of case/control permutations
+void vert_add(uint64_t *, uint64_t);
+void vert_get(uint32_t *, const uint64_t *, size_t, size_t);
+void bits_transpose(uint64_t *);
+void perm_mask_init(size_t *, const uint64_t *, size_t, size_t);
+void contingency_table_blk(uint32_t *, size_t *, const uint64_t *, size_t *, uint32_t *, size_t, size_t, size_t, size_t, bool);
 
 bool categorical_init(struct categorical_supp *, size_t, size_t);
-struct categorical_res categorical_impl(struct categorical_supp *, uint8_t *, size_t *, size_t, size_t, enum categorical_flags);
+struct categorical_res categorical_impl(struct categorical_supp *, size_t *, size_t *, size_t, size_t, enum categorical_flags);
 void categorical_close(struct categorical_supp *);
 
-bool maver_adj_init(struct maver_adj_supp *, size_t, size_t, size_t);
-struct maver_adj_res maver_adj_impl(struct maver_adj_supp *, uint8_t *, size_t *, size_t, size_t, size_t, size_t, size_t, gsl_rng *, enum categorical_flags);
+size_t maver_adj_stop_cnt(double);
+bool maver_adj_init(struct maver_adj_supp *, size_t, size_t, size_t, size_t, size_t, bool, size_t);
+struct maver_adj_res maver_adj_impl(struct maver_adj_supp *, size_t *, size_t *, size_t, size_t, size_t, struct maver_adj_par, size_t, size_t, uint64_t, struct maver_adj_ckpt_par *, enum categorical_flags);
+struct maver_adj_res maver_adj_impl_mt(struct maver_adj_supp *, struct thread_pool *, size_t *, size_t *, size_t, size_t, size_t, struct maver_adj_par, size_t, size_t, uint64_t, struct maver_adj_ckpt_par *, enum categorical_flags);
 void maver_adj_close(struct maver_adj_supp *);
+bool maver_adj_null_res(struct maver_adj_res *, float *const *, const size_t *, const double *, size_t, size_t, size_t);
+
+bool maver_adj_joint_init(struct maver_adj_joint_supp *, struct maver_adj_wnd *, size_t, size_t, size_t, size_t);
+void maver_adj_joint_impl(struct maver_adj_joint_supp *, struct thread_pool *, struct maver_adj_res *, size_t *, size_t *, size_t, size_t, size_t, size_t, uint64_t, enum categorical_flags);
+void maver_adj_joint_close(struct maver_adj_joint_supp *);
@@ -1,4 +1,5 @@
 #include "np.h"
+#include "ll.h"
 #include "genotypes.h"
 #include "tblproc.h"
 #include "memory.h"
@@ -7,6 +8,18 @@
 #include <string.h>
 #include <stdlib.h>
 
+// Returns count of words required to store genotypes of a single SNP
+size_t gen_pack_cnt(size_t phen_cnt)
+{
+    return TYPE_CNT(phen_cnt, SIZE_BIT) << 1;
+}
+
+uint8_t gen_pack_get(const size_t *gen, size_t ind)
+{
+    size_t off = (ind / SIZE_BIT) << 1, pos = ind % SIZE_BIT;
+    return (uint8_t) (((gen[off] >> pos) & 1) | (((gen[off + 1] >> pos) & 1) << 1));
+}
+
 #if 0
 
 typedef struct
@@ -2,6 +2,12 @@
 
 #include "common.h"
 
+// Packed genotype storage: for every 'SIZE_BIT' samples of a SNP two words holding the low and the high bits of 
+// the genotype codes are stored one after another. Codes '0', '1' and '2' denote genotypes, while '3' denotes missing value
+#define GEN_PACK_MISSING 3
+size_t gen_pack_cnt(size_t);
+uint8_t gen_pack_get(const size_t *, size_t);
+
 struct snp {
     size_t *pos; // length = snp_cnt
     uint8_t *all; // length = (snp_cnt + 3) / 4
@@ -1,4 +1,5 @@
 #include "ll.h"
+#include "memory.h"
 #include "gslsupp.h"
 
 #include <math.h>
@@ -25,6 +26,28 @@ double log_choose(size_t n, size_t m)
     return m > (n >> 1) ? log_fact(n) - log_fact(n - m) - log_fact(m) : log_fact(n) - log_fact(m) - log_fact(n - m); // Addition here may be not associative
 }
 
+// Table of 'log(n!)' for 'n' from 0 to 'cnt' inclusively
+double *log_fact_tbl_init(size_t cnt)
+{
+    double *tbl;
+    if (!array_init(&tbl, NULL, cnt + 1, sizeof(*tbl), 0, ARRAY_STRICT)) return NULL;
+    for (size_t i = 0; i <= cnt; i++) tbl[i] = log_fact(i);
+    return tbl;
+}
+
+// Same as 'log_choose', but the values of 'log_fact' are taken from the table
+double log_choose_tbl(const double *tbl, size_t n, size_t m)
+{
+    if (m > n) return nan(__func__);
+    return tbl[n] - tbl[m] - tbl[n - m];
+}
+
+// Logarithm of the hypergeometric probability. Arguments should satisfy 'max(0, t - n2) <= k <= min(t, n1) and t <= n1 + n2'
+double log_pdf_hypergeom_tbl(const double *tbl, size_t k, size_t n1, size_t n2, size_t t)
+{
+    return log_choose_tbl(tbl, n1, k) + log_choose_tbl(tbl, n2, t - k) - log_choose_tbl(tbl, n1 + n2, t);
+}
+
 double pdf_hypergeom(size_t k, size_t n1, size_t n2, size_t t)
 {
     size_t car, n12 = size_add(&car, n1, n2);
@@ -58,4 +81,25 @@ double cdf_gamma_Q(double x, double a, double b)
 double cdf_chisq_Q(double x, double df)
 {
     return cdf_gamma_Q(x, df / 2., 2.);
+}
+
+// Scaled complementary error function 'exp(x^2) erfc(x)' for non-negative 'x'
+static double erfc_scaled(double x)
+{
+    if (x < 25.) return exp(x * x) * erfc(x);
+    double y = .5 / (x * x); // Asymptotic expansion, the first omitted term '135135 y^7' is below 3e-17 for 'x >= 25'
+    return (1. - y * (1. - 3. * y * (1. - 5. * y * (1. - 7. * y * (1. - 9. * y * (1. - 11. * y)))))) / (x * 1.7724538509055160273); // sqrt(pi)
+}
+
+// Computes '-log10(cdf_chisq_Q(x, df))'. Closed forms are used for 'df' in 1, 2, 3, 4, which do not underflow for large 'x'
+double cdf_chisq_Q_nlog10(double x, double df)
+{
+    const double ln10 = 2.3025850929940456840;
+    if (x <= 0.) return 0.;
+    double h = .5 * x;
+    if (df == 1.) return (h - log(erfc_scaled(sqrt(h)))) / ln10;
+    if (df == 2.) return h / ln10;
+    if (df == 3.) return (h - log(erfc_scaled(sqrt(h)) + 1.1283791670955125739 * sqrt(h))) / ln10; // 2 / sqrt(pi)
+    if (df == 4.) return (h - log1p(h)) / ln10;
+    return -log10(cdf_chisq_Q(x, df));
 }
\ No newline at end of file
@@ -4,9 +4,13 @@
 
 double log_fact(size_t);
 double log_choose(size_t, size_t);
+double *log_fact_tbl_init(size_t);
+double log_choose_tbl(const double *, size_t, size_t);
+double log_pdf_hypergeom_tbl(const double *, size_t, size_t, size_t, size_t);
 double pdf_hypergeom(size_t, size_t, size_t, size_t);
 double gamma_inc_P(double, double);
 double gamma_inc_Q(double, double);
 
 double cdf_gamma_Q(double, double, double);
-double cdf_chisq_Q(double, double);
\ No newline at end of file
+double cdf_chisq_Q(double, double);
+double cdf_chisq_Q_nlog10(double, double);
\ No newline at end of file
@@ -88,6 +88,11 @@ uint32_t uint32_pop_cnt(uint32_t x)
     return __builtin_popcount(x);
 }
 
+bool cpu_avx2(void)
+{
+    return __builtin_cpu_supports("avx2");
+}
+
 #   ifdef __x86_64__
 
 size_t size_bit_scan_reverse(size_t x)
@@ -198,6 +203,28 @@ uint32_t uint32_pop_cnt(uint32_t x)
     return __popcnt((unsigned) x);
 }
 
+bool cpu_avx2(void)
+{
+    static volatile long res = -1; // Benign race: every thread computes the same value
+    if (res < 0)
+    {
+        int info[4];
+        __cpuid(info, 0);
+        bool avx2 = 0;
+        if (info[0] >= 7)
+        {
+            __cpuid(info, 1);
+            if ((info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6) // 'OSXSAVE', 'AVX', and the OS support of 'YMM' state
+            {
+                __cpuidex(info, 7, 0);
+                avx2 = !!(info[1] & (1 << 5));
+            }
+        }
+        res = avx2;
+    }
+    return res;
+}
+
 #   ifdef _M_X64
 
 void size_inc_interlocked(volatile size_t *mem)
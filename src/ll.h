@@ -78,6 +78,16 @@ size_t size_pop_cnt(size_t);
 size_t size_add_sat(size_t, size_t);
 size_t size_sub_sat(size_t, size_t);
 
+// Tests if the 'AVX2' instruction set is supported by the processor and the operating system
+bool cpu_avx2(void);
+
+// Marks functions using the 'AVX2' instructions, which are selected at runtime by 'cpu_avx2'
+#if defined __GNUC__ || defined __clang__
+#   define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#   define TARGET_AVX2
+#endif
+
 int size_stable_cmp_dsc(const void *, const void *, void *);
 int size_stable_cmp_asc(const void *, const void *, void *);
 bool size_cmp_dsc(const void *, const void *, void *);
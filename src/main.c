@@ -21,8 +21,11 @@
 #ifndef TEST_DEACTIVATE
 
 #   include "test.h"
+#   include "test_categorical.h"
+#   include "test_gslsupp.h"
 #   include "test_ll.h"
 #   include "test_np.h"
+#   include "test_rng.h"
 #   include "test_sort.h"
 #   include "test_utf8.h"
 
@@ -95,6 +98,79 @@ static bool test_main(struct log *log)
                 test_sort_c_2
             })
         },
+        {
+            NULL,
+            sizeof(struct test_gslsupp_a),
+            CLII((test_generator_callback[]) {
+                test_gslsupp_generator_a,
+            }),
+            CLII((test_callback[]) {
+                test_gslsupp_a,
+            })
+        },
+        {
+            NULL,
+            sizeof(struct test_categorical_b),
+            CLII((test_generator_callback[]) {
+                test_categorical_generator_b,
+            }),
+            CLII((test_callback[]) {
+                test_categorical_b,
+            })
+        },
+        {
+            NULL,
+            sizeof(struct test_categorical_c),
+            CLII((test_generator_callback[]) {
+                test_categorical_generator_c,
+            }),
+            CLII((test_callback[]) {
+                test_categorical_c,
+            })
+        },
+        {
+            NULL,
+            sizeof(struct test_categorical_d),
+            CLII((test_generator_callback[]) {
+                test_categorical_generator_d,
+            }),
+            CLII((test_callback[]) {
+                test_categorical_d,
+            })
+        },
+        {
+            NULL,
+            sizeof(struct test_categorical_e),
+            CLII((test_generator_callback[]) {
+                test_categorical_generator_e,
+            }),
+            CLII((test_callback[]) {
+                test_categorical_e_1,
+                test_categorical_e_2,
+                test_categorical_e_3,
+            })
+        },
+        {
+            NULL,
+            sizeof(struct test_rng_a),
+            CLII((test_generator_callback[]) {
+                test_rng_generator_a,
+            }),
+            CLII((test_callback[]) {
+                test_rng_a_1,
+                test_rng_a_2
+            })
+        },
+        {
+            NULL,
+            sizeof(struct test_rng_b),
+            CLII((test_generator_callback[]) {
+                test_rng_generator_b,
+            }),
+            CLII((test_callback[]) {
+                test_rng_b,
+            })
+        },
         {
             NULL,
             sizeof(struct test_utf8),
@@ -111,7 +187,7 @@ static bool test_main(struct log *log)
         }
     };
     log_message_generic(log, CODE_METRIC, MESSAGE_NOTE, "Test mode triggered!\n");
-    return test(group_arr, countof(group_arr), log);
+    return test(group_arr, countof(group_arr), log) && perf(log);
 }
 
 #else
@@ -134,7 +210,7 @@ struct main_args main_args_default()
 
 struct main_args main_args_override(struct main_args args_hi, struct main_args args_lo)
 {
-    struct main_args res = { .log_path = args_hi.log_path ? args_hi.log_path : args_lo.log_path };
+    struct main_args res = { .log_path = args_hi.log_path ? args_hi.log_path : args_lo.log_path, .rpl_max = args_hi.rpl_max, .mov_wnd = args_hi.mov_wnd, .tail = args_hi.tail, .budget = args_hi.budget, .rel_err = args_hi.rel_err, .kernel_sd = args_hi.kernel_sd, .time_budget = args_hi.time_budget };
     if (res.log_path && !strcmp(res.log_path, "stderr")) res.log_path = NULL;
     memcpy(res.bits, args_hi.bits, UINT8_CNT(MAIN_ARGS_BIT_CNT));
     if (uint8_bit_test(args_hi.bits, MAIN_ARGS_BIT_POS_THREAD_CNT)) res.thread_cnt = args_hi.thread_cnt;
@@ -172,16 +248,29 @@ static int Main(int argc, char **argv)
     // All names should be sorted according to 'strncmp'!!!
     struct argv_par_sch argv_par_sch =
     {
-        CLII((struct tag[]) { { STRI("help"), 0 }, { STRI("log"), 1 }, { STRI("test"), 2 }, { STRI("threads"), 3 }}),
-        CLII((struct tag[]) { { STRI("C"), 4 }, { STRI("L"), 5 }, { STRI("T"), 2 }, { STRI("h"), 0 }, { STRI("l"), 1 }, { STRI("t"), 3 } }),
+        CLII((struct tag[]) { { STRI("budget"), 15 }, { STRI("cache"), 17 }, { STRI("help"), 0 }, { STRI("joint"), 6 }, { STRI("kernel-sd"), 11 }, { STRI("log"), 1 }, { STRI("max"), 12 }, { STRI("mov-wnd"), 10 }, { STRI("recompute"), 18 }, { STRI("rel-err"), 7 }, { STRI("resume"), 13 }, { STRI("rpl-max"), 8 }, { STRI("scan"), 9 }, { STRI("tail"), 14 }, { STRI("test"), 2 }, { STRI("threads"), 3 }, { STRI("time-budget"), 16 }}),
+        CLII((struct tag[]) { { STRI("B"), 15 }, { STRI("C"), 4 }, { STRI("E"), 7 }, { STRI("G"), 14 }, { STRI("J"), 6 }, { STRI("K"), 11 }, { STRI("L"), 5 }, { STRI("M"), 12 }, { STRI("N"), 17 }, { STRI("P"), 18 }, { STRI("R"), 8 }, { STRI("S"), 9 }, { STRI("T"), 2 }, { STRI("U"), 13 }, { STRI("W"), 10 }, { STRI("h"), 0 }, { STRI("l"), 1 }, { STRI("t"), 3 } }),
         CLII((struct par_sch[])
         {
             { 0, &(struct handler_context) { offsetof(struct main_args, bits), MAIN_ARGS_BIT_POS_HELP }, empty_handler, 1 },
             { offsetof(struct main_args, log_path), NULL, p_str_handler, 0 },
             { 0, &(struct handler_context) { offsetof(struct main_args, bits), MAIN_ARGS_BIT_POS_TEST }, empty_handler, 1 },
-            { offsetof(struct main_args, thread_cnt), &(struct handler_context) { offsetof(struct main_args, bits), MAIN_ARGS_BIT_POS_THREAD_CNT }, size_handler, 0 },
+            { offsetof(struct main_args, thread_cnt), &(struct handler_context) { offsetof(struct main_args, bits) - offsetof(struct main_args, thread_cnt), MAIN_ARGS_BIT_POS_THREAD_CNT }, size_handler, 0 },
             { 0, &(struct handler_context) { offsetof(struct main_args, bits), MAIN_ARGS_BIT_POS_CAT }, empty_handler, 1 },
             { 0, &(struct handler_context) { offsetof(struct main_args, bits), MAIN_ARGS_BIT_POS_LDE }, empty_handler, 1 },
+            { 0, &(struct handler_context) { offsetof(struct main_args, bits), MAIN_ARGS_BIT_POS_JOINT }, empty_handler, 1 },
+            { offsetof(struct main_args, rel_err), &(struct handler_context) { offsetof(struct main_args, bits) - offsetof(struct main_args, rel_err), MAIN_ARGS_BIT_POS_REL_ERR }, flt64_handler, 0 },
+            { offsetof(struct main_args, rpl_max), &(struct handler_context) { offsetof(struct main_args, bits) - offsetof(struct main_args, rpl_max), MAIN_ARGS_BIT_POS_RPL_MAX }, size_handler, 0 },
+            { 0, &(struct handler_context) { offsetof(struct main_args, bits), MAIN_ARGS_BIT_POS_SCAN }, empty_handler, 1 },
+            { offsetof(struct main_args, mov_wnd), &(struct handler_context) { offsetof(struct main_args, bits) - offsetof(struct main_args, mov_wnd), MAIN_ARGS_BIT_POS_MOV_WND }, size_handler, 0 },
+            { offsetof(struct main_args, kernel_sd), &(struct handler_context) { offsetof(struct main_args, bits) - offsetof(struct main_args, kernel_sd), MAIN_ARGS_BIT_POS_KERNEL_SD }, flt64_handler, 0 },
+            { 0, &(struct handler_context) { offsetof(struct main_args, bits), MAIN_ARGS_BIT_POS_MAX }, empty_handler, 1 },
+            { 0, &(struct handler_context) { offsetof(struct main_args, bits), MAIN_ARGS_BIT_POS_RESUME }, empty_handler, 1 },
+            { offsetof(struct main_args, tail), &(struct handler_context) { offsetof(struct main_args, bits) - offsetof(struct main_args, tail), MAIN_ARGS_BIT_POS_TAIL }, size_handler, 0 },
+            { offsetof(struct main_args, budget), &(struct handler_context) { offsetof(struct main_args, bits) - offsetof(struct main_args, budget), MAIN_ARGS_BIT_POS_BUDGET }, size_handler, 0 },
+            { offsetof(struct main_args, time_budget), &(struct handler_context) { offsetof(struct main_args, bits) - offsetof(struct main_args, time_budget), MAIN_ARGS_BIT_POS_TIME_BUDGET }, flt64_handler, 0 },
+            { 0, &(struct handler_context) { offsetof(struct main_args, bits), MAIN_ARGS_BIT_POS_CACHE }, empty_handler, 1 },
+            { 0, &(struct handler_context) { offsetof(struct main_args, bits), MAIN_ARGS_BIT_POS_RECOMPUTE }, empty_handler, 1 },
         })
     };
 
@@ -393,11 +482,31 @@ static int Main(int argc, char **argv)
             }
             else if (uint8_bit_test(main_args.bits, MAIN_ARGS_BIT_POS_CAT))
             {
-                if (pos_cnt >= 6)
+                // Genome-wide scan mode: phenotypes, genotypes, binary output, and optional CSV output
+                if (uint8_bit_test(main_args.bits, MAIN_ARGS_BIT_POS_SCAN))
+                {
+                    if (pos_cnt >= 3) categorical_scan(pos_arr[0], pos_arr[1], pos_arr[2], pos_cnt >= 4 ? pos_arr[3] : NULL, main_args.thread_cnt, &log);
+                }
+                // Recomputation mode: cache of the null distribution and output
+                else if (uint8_bit_test(main_args.bits, MAIN_ARGS_BIT_POS_RECOMPUTE))
+                {
+                    if (pos_cnt >= 2) categorical_recompute(pos_arr[0], pos_arr[1],
+                        uint8_bit_test(main_args.bits, MAIN_ARGS_BIT_POS_RPL_MAX) ? main_args.rpl_max : 0,
+                        uint8_bit_test(main_args.bits, MAIN_ARGS_BIT_POS_REL_ERR) ? main_args.rel_err : 0.,
+                        uint8_bit_test(main_args.bits, MAIN_ARGS_BIT_POS_TAIL) ? main_args.tail : 0, &log);
+                }
+                else if (pos_cnt >= 6)
                 {
                     size_t rpl = (size_t) strtoull(pos_arr[4], NULL, 10);
                     uint64_t seed = (uint64_t) strtoull(pos_arr[5], NULL, 10);
-                    categorical_run(pos_arr[0], pos_arr[1], pos_arr[2], pos_arr[3], rpl, seed, &log);
+                    if (uint8_bit_test(main_args.bits, MAIN_ARGS_BIT_POS_RPL_MAX)) rpl = main_args.rpl_max;
+                    double rel_err = uint8_bit_test(main_args.bits, MAIN_ARGS_BIT_POS_REL_ERR) ? main_args.rel_err : 0.;
+                    size_t mov_wnd = uint8_bit_test(main_args.bits, MAIN_ARGS_BIT_POS_MOV_WND) ? main_args.mov_wnd : 0;
+                    size_t tail = uint8_bit_test(main_args.bits, MAIN_ARGS_BIT_POS_TAIL) ? main_args.tail : 0;
+                    size_t budget = uint8_bit_test(main_args.bits, MAIN_ARGS_BIT_POS_BUDGET) ? main_args.budget : 0;
+                    double time_budget = uint8_bit_test(main_args.bits, MAIN_ARGS_BIT_POS_TIME_BUDGET) ? main_args.time_budget : 0.;
+                    double kernel_sd = uint8_bit_test(main_args.bits, MAIN_ARGS_BIT_POS_KERNEL_SD) ? main_args.kernel_sd : 0.;
+                    categorical_run(pos_arr[0], pos_arr[1], pos_arr[2], pos_arr[3], rpl, rel_err, mov_wnd, kernel_sd, uint8_bit_test(main_args.bits, MAIN_ARGS_BIT_POS_MAX), tail, budget, time_budget, uint8_bit_test(main_args.bits, MAIN_ARGS_BIT_POS_CACHE), seed, main_args.thread_cnt, uint8_bit_test(main_args.bits, MAIN_ARGS_BIT_POS_JOINT), uint8_bit_test(main_args.bits, MAIN_ARGS_BIT_POS_RESUME), &log);
                 }
             }
             else if (uint8_bit_test(main_args.bits, MAIN_ARGS_BIT_POS_LDE))
@@ -10,12 +10,26 @@ enum {
     MAIN_ARGS_BIT_POS_TEST,
     MAIN_ARGS_BIT_POS_CAT,
     MAIN_ARGS_BIT_POS_LDE,
+    MAIN_ARGS_BIT_POS_JOINT,
+    MAIN_ARGS_BIT_POS_REL_ERR,
+    MAIN_ARGS_BIT_POS_RPL_MAX,
+    MAIN_ARGS_BIT_POS_SCAN,
+    MAIN_ARGS_BIT_POS_MOV_WND,
+    MAIN_ARGS_BIT_POS_KERNEL_SD,
+    MAIN_ARGS_BIT_POS_MAX,
+    MAIN_ARGS_BIT_POS_RESUME,
+    MAIN_ARGS_BIT_POS_TAIL,
+    MAIN_ARGS_BIT_POS_BUDGET,
+    MAIN_ARGS_BIT_POS_TIME_BUDGET,
+    MAIN_ARGS_BIT_POS_CACHE,
+    MAIN_ARGS_BIT_POS_RECOMPUTE,
     MAIN_ARGS_BIT_CNT
 };
 
 struct main_args {
     char *log_path;
-    size_t thread_cnt;
+    size_t thread_cnt, rpl_max, mov_wnd, tail, budget;
+    double rel_err, kernel_sd, time_budget;
     uint8_t bits[UINT8_CNT(MAIN_ARGS_BIT_CNT)];
 };
 
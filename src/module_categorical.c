@@ -3,12 +3,17 @@
 #include "memory.h"
 #include "tblproc.h"
 #include "categorical.h"
+#include "genotypes.h"
 #include "sort.h"
+#include "threadpool.h"
 
 #include "module_categorical.h"
 
 #include <string.h>
+#include <stdlib.h>
 #include <inttypes.h>
+#include <math.h>
+#include <gsl/gsl_errno.h>
 
 struct phen_context {
     struct str_tbl_handler_context handler_context;
@@ -46,11 +51,24 @@ static bool tbl_gen_selector(struct tbl_col *cl, size_t row, size_t col, void *t
     return 1;
 }
 
+// Genotypes are stored in the packed form (see 'genotypes.h'). Words are assembled in registers, since parsing limits the scan mode
 static bool gen_handler(const char *str, size_t len, void *res, void *Context)
 {
     struct gen_context *context = Context;
     if (len != context->phen_cnt) return 0;
-    for (size_t i = 0; i < len; i++) ((uint8_t *) res)[i]  = (uint8_t) str[i] - '0';
+    size_t *gen = res;
+    for (size_t i = 0, j = 0; i < len; i += SIZE_BIT, j += 2)
+    {
+        size_t lo = 0, hi = 0, lim = MIN(len - i, SIZE_BIT);
+        for (size_t k = 0; k < lim; k++)
+        {
+            size_t val = MIN((uint8_t) (str[i + k] - '0'), GEN_PACK_MISSING);
+            lo |= (val & 1) << k;
+            hi |= (val >> 1) << k;
+        }
+        gen[j] = lo;
+        gen[j + 1] = hi;
+    }
     return 1;
 }
 
@@ -63,9 +81,10 @@ static bool tbl_gen_selector2(struct tbl_col *cl, size_t row, size_t col, void *
         cl->handler.read = NULL;
         return 1;
     }
-    if (!array_test(tbl, &context->gen_cap, 1, 0, 0, context->gen_cnt, context->phen_cnt)) return 0;
-    *cl = (struct tbl_col) { .handler = { .read = gen_handler }, .ptr = *(uint8_t **) tbl + context->gen_cnt, .context = context };
-    context->gen_cnt += context->phen_cnt;
+    size_t cnt = gen_pack_cnt(context->phen_cnt);
+    if (!array_test(tbl, &context->gen_cap, sizeof(size_t), 0, 0, context->gen_cnt, cnt)) return 0;
+    *cl = (struct tbl_col) { .handler = { .read = gen_handler }, .ptr = *(size_t **) tbl + context->gen_cnt, .context = context };
+    context->gen_cnt += cnt;
     return 1;
 }
 
@@ -116,14 +135,503 @@ bool append_out(const char *path_out, struct maver_adj_res res, struct log *log)
     return succ;
 }
 
-bool categorical_run(const char *path_phen, const char *path_gen, const char *path_top_hit, const char *path_out, size_t rpl, uint64_t seed, struct log *log)
+static void categorical_out(FILE *f, struct log *log, struct maver_adj_res res, size_t ind, size_t left, size_t right, uint64_t t0, uint64_t t1)
 {
-    uint8_t *gen = NULL;
-    gsl_rng *rng = NULL;    
-    size_t *phen = NULL;
+    log_message_generic(log, CODE_METRIC, MESSAGE_INFO, "Adjusted P-value for window %zu:%zu no. %zu: "
+        "[%s] %f, %zu, (%f, %f); [%s] %f, %zu, (%f, %f); [%s] %f, %zu, (%f, %f); [%s] %f, %zu, (%f, %f).\n",
+        left + 1, right + 1, ind + 1,
+        "CD", res.nlpv[0], res.rpl[0], res.ci_lo[0], res.ci_hi[0], "R", res.nlpv[1], res.rpl[1], res.ci_lo[1], res.ci_hi[1],
+        "D", res.nlpv[2], res.rpl[2], res.ci_lo[2], res.ci_hi[2], "A", res.nlpv[3], res.rpl[3], res.ci_lo[3], res.ci_hi[3]);
+    if (res.tail[0] || res.tail[1] || res.tail[2] || res.tail[3]) log_message_generic(log, CODE_METRIC, MESSAGE_INFO, "P-values of window no. %zu are extrapolated by the tail approximation for:%s%s%s%s.\n", 
+        ind + 1, res.tail[0] ? " CD" : "", res.tail[1] ? " R" : "", res.tail[2] ? " D" : "", res.tail[3] ? " A" : "");
+    log_message_time_diff(log, CODE_METRIC, MESSAGE_INFO, t0, t1, "Adjusted P-value computation took ");
+
+    int64_t diff = t1 - t0, mdq = diff / 60000000, mdr = diff % 60000000;
+    double sec = 1.e-6 * (double) mdr;
+    fprintf(f, "%zu", ind + 1);
+    for (size_t i = 0; i < ALT_CNT; i++) fprintf(f, ",%.15e,%zu,%.15e,%.15e", res.nlpv[i], res.rpl[i], res.ci_lo[i], res.ci_hi[i]);
+    fprintf(f, ",%" PRId64 " min,%.6f sec\n", mdq, sec);
+    fflush(f);
+}
+
+// Checkpoint of the independent mode. The header is followed by 'top_hit_cnt' records of 'struct categorical_ckpt_wnd' in the native byte order
+struct categorical_ckpt_head {
+    char magic[8];
+    uint32_t ver, type;
+    uint64_t top_hit_cnt, snp_cnt, phen_cnt, rpl, k, seed, wnd, tail;
+    double sd;
+};
+
+#define CATEGORICAL_CKPT_MAGIC "RMTCKPT"
+#define CATEGORICAL_CKPT_VER 2
+#define CATEGORICAL_CKPT_PERIOD 60000000 // Minimal time between the checkpoints in microseconds
+
+struct categorical_ckpt_wnd {
+    struct maver_adj_ckpt state;
+    struct maver_adj_res res;
+    uint64_t time; // Computation time of the finished window
+    uint8_t done;
+};
+
+struct categorical_ckpt {
+    struct categorical_ckpt_head head;
+    struct categorical_ckpt_wnd *wnd;
+    char *path, *path_tmp;
+    uint64_t time; // Time of the last save
+    struct log *log;
+    mutex_handle mutex;
+};
+
+struct categorical_ckpt_arg {
+    struct categorical_ckpt *ckpt;
+    size_t ind;
+};
+
+// Path of the auxiliary file next to the output
+static char *categorical_path_ext(const char *path, const char *ext)
+{
+    char *res = NULL;
+    size_t len = strlen(path), ext_len = strlen(ext);
+    if (!array_init(&res, NULL, len + ext_len + 1, sizeof(*res), 0, ARRAY_STRICT)) return NULL;
+    memcpy(res, path, len);
+    memcpy(res + len, ext, ext_len + 1);
+    return res;
+}
+
+static bool categorical_ckpt_init(struct categorical_ckpt *ckpt, const char *path_out, struct categorical_ckpt_head head, struct log *log)
+{
+    *ckpt = (struct categorical_ckpt) { .head = head, .time = get_time(), .log = log };
+    if (!array_init(&ckpt->wnd, NULL, (size_t) head.top_hit_cnt, sizeof(*ckpt->wnd), 0, ARRAY_STRICT | ARRAY_CLEAR) ||
+        !(ckpt->path = categorical_path_ext(path_out, ".ckpt")) ||
+        !(ckpt->path_tmp = categorical_path_ext(path_out, ".ckpt.tmp"))) goto error;
+    if (mutex_init(&ckpt->mutex)) return 1;
+
+error:
+    free(ckpt->path_tmp);
+    free(ckpt->path);
+    free(ckpt->wnd);
+    log_message_crt(log, CODE_METRIC, MESSAGE_ERROR, errno);
+    return 0;
+}
+
+static void categorical_ckpt_close(struct categorical_ckpt *ckpt)
+{
+    if (!ckpt->wnd) return;
+    mutex_close(&ckpt->mutex);
+    free(ckpt->path_tmp);
+    free(ckpt->path);
+    free(ckpt->wnd);
+}
+
+// Missing checkpoint is not an error, while the checkpoint of another run is
+static bool categorical_ckpt_load(struct categorical_ckpt *ckpt)
+{
+    FILE *f = fopen(ckpt->path, "rb");
+    if (!f)
+    {
+        log_message_generic(ckpt->log, CODE_METRIC, MESSAGE_WARNING, "Unable to open the checkpoint \"%s\". Simulations are started from scratch!\n", ckpt->path);
+        return 1;
+    }
+    size_t cnt = (size_t) ckpt->head.top_hit_cnt;
+    struct categorical_ckpt_head head;
+    bool succ = fread(&head, sizeof(head), 1, f) == 1 && !memcmp(&head, &ckpt->head, sizeof(head)) && fread(ckpt->wnd, sizeof(*ckpt->wnd), cnt, f) == cnt;
+    Fclose(f);
+    if (succ) log_message_generic(ckpt->log, CODE_METRIC, MESSAGE_INFO, "Simulations are resumed from the checkpoint \"%s\".\n", ckpt->path);
+    else log_message_generic(ckpt->log, CODE_METRIC, MESSAGE_ERROR, "Checkpoint \"%s\" is corrupted or does not match the input data and the parameters!\n", ckpt->path);
+    return succ;
+}
+
+// Checkpoint is written to the temporary file which then replaces the previous one. Should be called under the lock
+static void categorical_ckpt_save(struct categorical_ckpt *ckpt)
+{
+    size_t cnt = (size_t) ckpt->head.top_hit_cnt;
+    FILE *f = fopen(ckpt->path_tmp, "wb");
+    if (!f)
+    {
+        log_message_fopen(ckpt->log, CODE_METRIC, MESSAGE_WARNING, ckpt->path_tmp, errno);
+        return;
+    }
+    bool succ = fwrite(&ckpt->head, sizeof(ckpt->head), 1, f) == 1 && fwrite(ckpt->wnd, sizeof(*ckpt->wnd), cnt, f) == cnt;
+    succ &= !Fclose(f);
+    if (succ && (!rename(ckpt->path_tmp, ckpt->path) || (!remove(ckpt->path) && !rename(ckpt->path_tmp, ckpt->path)))) ckpt->time = get_time();
+    else log_message_generic(ckpt->log, CODE_METRIC, MESSAGE_WARNING, "Unable to write the checkpoint \"%s\"!\n", ckpt->path);
+}
+
+static void categorical_ckpt_save_period(struct categorical_ckpt *ckpt)
+{
+    if (get_time() - ckpt->time >= CATEGORICAL_CKPT_PERIOD) categorical_ckpt_save(ckpt);
+}
+
+static void categorical_ckpt_callback(const struct maver_adj_ckpt *state, void *Arg)
+{
+    struct categorical_ckpt_arg *arg = Arg;
+    struct categorical_ckpt *ckpt = arg->ckpt;
+    mutex_acquire(&ckpt->mutex);
+    struct categorical_ckpt_wnd *wnd = ckpt->wnd + arg->ind;
+    if (!wnd->done && state->blk > wnd->state.blk) wnd->state = *state;
+    categorical_ckpt_save_period(ckpt);
+    mutex_release(&ckpt->mutex);
+}
+
+// Results of the unfinished windows are stored by the scheduler. Computation time is accumulated
+static void categorical_ckpt_res(struct categorical_ckpt *ckpt, size_t ind, struct maver_adj_res res, uint64_t time, bool done)
+{
+    mutex_acquire(&ckpt->mutex);
+    ckpt->wnd[ind].res = res;
+    ckpt->wnd[ind].time += time;
+    ckpt->wnd[ind].done = done;
+    categorical_ckpt_save_period(ckpt);
+    mutex_release(&ckpt->mutex);
+}
+
+// Checkpoint is only needed for the resumption, thus it is removed when all windows are finished. Otherwise, the final state is saved
+static void categorical_ckpt_finish(struct categorical_ckpt *ckpt, struct interval *top_hit, size_t snp_cnt)
+{
+    size_t cnt = (size_t) ckpt->head.top_hit_cnt;
+    for (size_t i = 0; i < cnt; i++)
+    {
+        size_t left = top_hit[i].left - 1, right = top_hit[i].right - 1;
+        if (left > right || right >= snp_cnt || ckpt->wnd[i].done) continue;
+        categorical_ckpt_save(ckpt);
+        return;
+    }
+    remove(ckpt->path_tmp);
+    if (remove(ckpt->path) && errno != ENOENT) log_message_generic(ckpt->log, CODE_METRIC, MESSAGE_WARNING, "Unable to remove the checkpoint \"%s\"!\n", ckpt->path);
+}
+
+// Window is continued from the saved state. Statistics of the tail approximation and the cache are not saved, 
+// thus the unfinished windows are restarted if either of them is enabled
+static struct maver_adj_res categorical_ckpt_impl(struct categorical_ckpt *ckpt, size_t ind, struct maver_adj_supp *supp, struct thread_pool *pool, size_t *gen, size_t *phen, size_t snp_cnt, size_t phen_cnt, size_t phen_ucnt, struct maver_adj_par par, size_t rpl, size_t k, uint64_t seed)
+{
+    mutex_acquire(&ckpt->mutex);
+    struct maver_adj_ckpt state = ckpt->wnd[ind].state;
+    mutex_release(&ckpt->mutex);
+    struct categorical_ckpt_arg arg = { .ckpt = ckpt, .ind = ind };
+    struct maver_adj_ckpt_par ckpt_par = { .init = state.blk && !supp->tail && !supp->null ? &state : NULL, .callback = categorical_ckpt_callback, .context = &arg };
+    return pool ?
+        maver_adj_impl_mt(supp, pool, gen, phen, snp_cnt, phen_cnt, phen_ucnt, par, rpl, k, seed, &ckpt_par, 15) :
+        maver_adj_impl(supp, gen, phen, snp_cnt, phen_cnt, phen_ucnt, par, rpl, k, seed, &ckpt_par, 15);
+}
+
+// Cache of the null distribution. The header is followed by the records of the windows in the order of completion. Every record
+// is followed by 'cnt[i]' permuted statistics of each alternative in the order of the replicates. Native byte order is used
+struct categorical_null_head {
+    char magic[8];
+    uint32_t ver, alt_cnt;
+    uint64_t top_hit_cnt;
+};
+
+struct categorical_null_rec {
+    uint64_t ind, left, right, cnt[ALT_CNT];
+    double density[ALT_CNT]; // Observed statistics
+};
+
+#define CATEGORICAL_NULL_MAGIC "RMTNULL"
+#define CATEGORICAL_NULL_VER 1
+
+struct categorical_null {
+    FILE *f;
+    char *path;
+    struct log *log;
+    mutex_handle mutex;
+};
+
+static bool categorical_null_init(struct categorical_null *null, const char *path_out, size_t top_hit_cnt, struct log *log)
+{
+    *null = (struct categorical_null) { .log = log };
+    struct categorical_null_head head = { .magic = CATEGORICAL_NULL_MAGIC, .ver = CATEGORICAL_NULL_VER, .alt_cnt = ALT_CNT, .top_hit_cnt = top_hit_cnt };
+    if (!(null->path = categorical_path_ext(path_out, ".null"))) log_message_crt(log, CODE_METRIC, MESSAGE_ERROR, errno);
+    else if (!(null->f = fopen(null->path, "wb"))) log_message_fopen(log, CODE_METRIC, MESSAGE_ERROR, null->path, errno);
+    else if (fwrite(&head, sizeof(head), 1, null->f) == 1 && mutex_init(&null->mutex)) return 1;
+    Fclose(null->f);
+    free(null->path);
+    null->f = NULL;
+    return 0;
+}
+
+static void categorical_null_close(struct categorical_null *null)
+{
+    if (!null->f) return;
+    mutex_close(&null->mutex);
+    Fclose(null->f);
+    free(null->path);
+}
+
+static void categorical_null_write(struct categorical_null *null, size_t ind, size_t left, size_t right, struct maver_adj_supp *supp, struct maver_adj_res res, size_t rpl)
+{
+    struct categorical_null_rec rec = { .ind = ind, .left = left, .right = right };
+    for (size_t i = 0; i < ALT_CNT; i++) rec.cnt[i] = res.rpl[i], rec.density[i] = supp->density[i];
+    mutex_acquire(&null->mutex);
+    bool succ = fwrite(&rec, sizeof(rec), 1, null->f) == 1;
+    for (size_t i = 0; succ && i < ALT_CNT; i++) succ = fwrite(supp->null + i * rpl, sizeof(*supp->null), res.rpl[i], null->f) == res.rpl[i];
+    mutex_release(&null->mutex);
+    if (!succ) log_message_generic(null->log, CODE_METRIC, MESSAGE_WARNING, "Unable to write the cache \"%s\"!\n", null->path);
+}
+
+struct categorical_wnd_res {
+    struct maver_adj_res res;
+    uint64_t t0, t1;
+};
+
+struct categorical_wnd_context {
+    struct thread_pool *pool;
+    struct categorical_ckpt *ckpt;
+    struct categorical_null *null;
+    struct interval *top_hit;
+    struct categorical_wnd_res *wnd_res;
+    struct maver_adj_par par;
+    uint8_t *wnd_bits; // Bits of the windows which are ready to be written
+    size_t *gen, *phen, phen_cnt, phen_ucnt, snp_cnt, rpl, tail, k, top_hit_cnt, top_hit_out, pend;
+    uint64_t seed;
+    FILE *f;
+    struct log *log;
+    mutex_handle mutex;
+    condition_handle condition;
+};
+
+// Results are written in the order of the intervals
+static void categorical_wnd_out(struct categorical_wnd_context *context)
+{
+    for (; context->top_hit_out < context->top_hit_cnt && uint8_bit_test(context->wnd_bits, context->top_hit_out); context->top_hit_out++)
+    {
+        size_t i = context->top_hit_out, l = context->top_hit[i].left - 1, r = context->top_hit[i].right - 1;
+        if (l > r || r >= context->snp_cnt) continue;
+        categorical_out(context->f, context->log, context->wnd_res[i].res, i, l, r, context->wnd_res[i].t0, context->wnd_res[i].t1);
+    }
+}
+
+static bool categorical_wnd_thread_proc(void *Ind, void *Context)
+{
+    size_t ind = *(size_t *) Ind;
+    struct categorical_wnd_context *context = Context;
+    struct maver_adj_supp *supp = thread_pool_get_thread_data(context->pool, NULL, NULL);
+    size_t left = context->top_hit[ind].left - 1, right = context->top_hit[ind].right - 1;
+
+    uint64_t t0 = get_time();
+    struct maver_adj_res res = categorical_ckpt_impl(context->ckpt, ind, supp, NULL, context->gen + left * gen_pack_cnt(context->phen_cnt), context->phen, right - left + 1, context->phen_cnt, context->phen_ucnt, context->par, context->rpl, context->k, context->seed + ind);
+    uint64_t t1 = get_time();
+    categorical_ckpt_res(context->ckpt, ind, res, t1 - t0, 1);
+    if (context->null) categorical_null_write(context->null, ind, left, right, supp, res, context->rpl);
+
+    mutex_acquire(&context->mutex);
+    context->wnd_res[ind] = (struct categorical_wnd_res) { .res = res, .t0 = t0, .t1 = t1 };
+    uint8_bit_set(context->wnd_bits, ind);
+    categorical_wnd_out(context);
+    if (!--context->pend) condition_broadcast(&context->condition);
+    mutex_release(&context->mutex);
+    return 1;
+}
+
+// Windows are processed in parallel, the most expensive ones go first. Windows finished before the checkpoint are written without recomputation
+static bool categorical_wnd_mt(struct categorical_wnd_context *context, size_t wnd, size_t wnd_cnt, size_t thread_cnt)
+{
+    bool succ = 0;
+    size_t top_hit_cnt = context->top_hit_cnt, *cost = NULL, *wnd_ind = NULL;
+    uintptr_t *ord = NULL;
+    struct task *tasks = NULL;
+    if (!array_init(&context->wnd_res, NULL, top_hit_cnt, sizeof(*context->wnd_res), 0, ARRAY_STRICT) ||
+        !array_init(&context->wnd_bits, NULL, UINT8_CNT(top_hit_cnt), sizeof(*context->wnd_bits), 0, ARRAY_STRICT | ARRAY_CLEAR) ||
+        !array_init(&cost, NULL, wnd_cnt, sizeof(*cost), 0, ARRAY_STRICT) ||
+        !array_init(&wnd_ind, NULL, wnd_cnt, sizeof(*wnd_ind), 0, ARRAY_STRICT) ||
+        !array_init(&tasks, NULL, wnd_cnt, sizeof(*tasks), 0, ARRAY_STRICT)) goto error;
+
+    // Estimating the costs of the windows. Wrong intervals are marked as ready to be written and are skipped
+    size_t task_cnt = 0;
+    for (size_t i = 0; i < top_hit_cnt; i++)
+    {
+        size_t left = context->top_hit[i].left - 1, right = context->top_hit[i].right - 1;
+        struct categorical_ckpt_wnd *ckpt_wnd = context->ckpt->wnd + i;
+        if (left > right || right >= context->snp_cnt) uint8_bit_set(context->wnd_bits, i);
+        else if (ckpt_wnd->done)
+        {
+            context->wnd_res[i] = (struct categorical_wnd_res) { .res = ckpt_wnd->res, .t1 = ckpt_wnd->time };
+            uint8_bit_set(context->wnd_bits, i);
+        }
+        else cost[task_cnt] = (right - left + 1) * context->rpl, wnd_ind[task_cnt++] = i;
+    }
+    categorical_wnd_out(context);
+    if (!task_cnt)
+    {
+        succ = 1;
+        goto error;
+    }
+    ord = orders_stable(cost, task_cnt, sizeof(*cost), size_stable_cmp_dsc, NULL);
+    if (!ord) goto error;
+    for (size_t i = 0; i < task_cnt; i++) tasks[i] = (struct task) { .callback = categorical_wnd_thread_proc, .arg = wnd_ind + ord[i], .context = context };
+
+    size_t ind = 0;
+    for (; ind < thread_cnt; ind++)
+        if (!maver_adj_init(thread_pool_fetch_thread_data(context->pool, ind, NULL), wnd, context->phen_cnt, context->phen_ucnt, context->rpl, context->tail, !!context->null, 1)) break;
+    if (ind == thread_cnt && mutex_init(&context->mutex))
+    {
+        if (condition_init(&context->condition))
+        {
+            context->pend = task_cnt;
+            if (thread_pool_enqueue_tasks(context->pool, tasks, task_cnt, 0))
+            {
+                mutex_acquire(&context->mutex);
+                while (context->pend) condition_sleep(&context->condition, &context->mutex);
+                mutex_release(&context->mutex);
+                succ = 1;
+            }
+            condition_close(&context->condition);
+        }
+        mutex_close(&context->mutex);
+    }
+    while (ind--) maver_adj_close(thread_pool_fetch_thread_data(context->pool, ind, NULL));
+
+error:
+    free(tasks);
+    free(ord);
+    free(wnd_ind);
+    free(cost);
+    free(context->wnd_res);
+    free(context->wnd_bits);
+    return succ;
+}
+
+// Minimal count of blocks in a chunk of the scheduler
+#define CATEGORICAL_SCHED_BLK 16
+
+// Relative width of the confidence interval maximized over the unfinished alternatives
+static double categorical_sched_width(const struct categorical_ckpt_wnd *wnd)
+{
+    double res = -HUGE_VAL;
+    for (size_t i = 0; i < ALT_CNT; i++) if (!(wnd->state.stop & (1 << i)))
+    {
+        double lo = wnd->res.ci_lo[i], hi = wnd->res.ci_hi[i], width = lo > 0. && hi > 0. ? log(hi / lo) : HUGE_VAL;
+        if (width > res) res = width;
+    }
+    return res;
+}
+
+// Replicates are distributed between all windows under the global budget of replicates or time. The next chunk of blocks is given 
+// to the window with the largest uncertainty, and its size equals the count of blocks already simulated for the window. The state 
+// of the windows is kept by the checkpoint, thus the chunk continues the stream of blocks of the window and the budget can be extended on resumption
+static bool categorical_sched(FILE *f, struct categorical_ckpt *ckpt, struct interval *top_hit, size_t top_hit_cnt, size_t wnd, size_t *gen, size_t *phen, size_t snp_cnt, size_t phen_cnt, size_t phen_ucnt, struct maver_adj_par par, size_t rpl, size_t k, uint64_t seed, size_t budget, double time_budget, size_t thread_cnt, struct log *log)
+{
+    bool succ = 0;
+    struct thread_pool *pool = NULL;
+    struct maver_adj_supp supp = { 0 };
+    if (thread_cnt > 1)
+    {
+        pool = thread_pool_create(thread_cnt, thread_cnt, 0);
+        if (!pool) goto error;
+    }
+    else thread_cnt = 1;
+    if (!maver_adj_init(&supp, wnd, phen_cnt, phen_ucnt, rpl, 0, 0, thread_cnt)) goto error;
+
+    size_t rpl_cnt = 0;
+    for (size_t i = 0; i < top_hit_cnt; i++)
+    {
+        struct categorical_ckpt_wnd *ckpt_wnd = ckpt->wnd + i;
+        rpl_cnt += MIN((size_t) ckpt_wnd->state.blk * MAVER_ADJ_BLK, rpl);
+        if (ckpt_wnd->done || ckpt_wnd->state.blk) continue;
+        for (size_t j = 0; j < ALT_CNT; j++) ckpt_wnd->res.nlpv[j] = ckpt_wnd->res.ci_lo[j] = ckpt_wnd->res.ci_hi[j] = nan(__func__);
+    }
+
+    uint64_t t0 = get_time();
+    for (;;)
+    {
+        if (budget && rpl_cnt >= budget)
+        {
+            log_message_generic(log, CODE_METRIC, MESSAGE_INFO, "Budget of replicates is exhausted after %zu replicates.\n", rpl_cnt);
+            break;
+        }
+        if (time_budget > 0. && 1.e-6 * (double) (get_time() - t0) >= time_budget)
+        {
+            log_message_generic(log, CODE_METRIC, MESSAGE_INFO, "Budget of time is exhausted after %zu replicates.\n", rpl_cnt);
+            break;
+        }
+
+        // Windows are compared by the uncertainty, then by the count of blocks simulated, then by the index
+        size_t ind = SIZE_MAX;
+        double width = 0.;
+        for (size_t i = 0; i < top_hit_cnt; i++)
+        {
+            size_t left = top_hit[i].left - 1, right = top_hit[i].right - 1;
+            struct categorical_ckpt_wnd *ckpt_wnd = ckpt->wnd + i;
+            if (left > right || right >= snp_cnt || ckpt_wnd->done) continue;
+            double tmp = categorical_sched_width(ckpt_wnd);
+            if (ind == SIZE_MAX || tmp > width || (tmp == width && ckpt_wnd->state.blk < ckpt->wnd[ind].state.blk)) ind = i, width = tmp;
+        }
+        if (ind == SIZE_MAX) break;
+
+        struct categorical_ckpt_wnd *ckpt_wnd = ckpt->wnd + ind;
+        size_t left = top_hit[ind].left - 1, right = top_hit[ind].right - 1, blk = (size_t) ckpt_wnd->state.blk, cnt = MAX(blk, CATEGORICAL_SCHED_BLK);
+        if (budget) cnt = MIN(cnt, (budget - rpl_cnt + MAVER_ADJ_BLK - 1) / MAVER_ADJ_BLK);
+        size_t lim = MIN((blk + cnt) * MAVER_ADJ_BLK, rpl);
+
+        uint64_t t1 = get_time();
+        struct maver_adj_res res = categorical_ckpt_impl(ckpt, ind, &supp, pool, gen + left * gen_pack_cnt(phen_cnt), phen, right - left + 1, phen_cnt, phen_ucnt, par, lim, k, seed + ind);
+        size_t blk_next = (size_t) ckpt_wnd->state.blk;
+        rpl_cnt += MIN(blk_next * MAVER_ADJ_BLK, rpl) - MIN(blk * MAVER_ADJ_BLK, rpl);
+        categorical_ckpt_res(ckpt, ind, res, get_time() - t1, ckpt_wnd->state.stop == (1u << ALT_CNT) - 1 || blk_next * MAVER_ADJ_BLK >= rpl || blk_next == blk);
+    }
+    for (size_t i = 0; i < top_hit_cnt; i++)
+    {
+        size_t left = top_hit[i].left - 1, right = top_hit[i].right - 1;
+        if (left <= right && right < snp_cnt) categorical_out(f, log, ckpt->wnd[i].res, i, left, right, 0, ckpt->wnd[i].time);
+    }
+    succ = 1;
+
+error:
+    maver_adj_close(&supp);
+    thread_pool_dispose(pool, NULL);
+    return succ;
+}
+
+// Every permutation of phenotypes is shared by all windows
+static bool categorical_joint(FILE *f, struct interval *top_hit, size_t top_hit_cnt, size_t wnd_cnt, size_t *gen, size_t *phen, size_t snp_cnt, size_t phen_cnt, size_t phen_ucnt, size_t rpl, size_t k, uint64_t seed, size_t thread_cnt, struct log *log)
+{
+    bool succ = 0;
+    struct thread_pool *pool = NULL;
+    struct maver_adj_wnd *wnd = NULL;
+    struct maver_adj_res *res = NULL;
+    struct maver_adj_joint_supp supp = { 0 };
+    if (!array_init(&wnd, NULL, wnd_cnt, sizeof(*wnd), 0, ARRAY_STRICT) ||
+        !array_init(&res, NULL, wnd_cnt, sizeof(*res), 0, ARRAY_STRICT)) goto error;
+    for (size_t i = 0, j = 0; i < top_hit_cnt; i++)
+    {
+        size_t left = top_hit[i].left - 1, right = top_hit[i].right - 1;
+        if (left <= right && right < snp_cnt) wnd[j++] = (struct maver_adj_wnd) { .off = left, .cnt = right - left + 1 };
+    }
+    if (thread_cnt > 1)
+    {
+        pool = thread_pool_create(thread_cnt, thread_cnt, 0);
+        if (!pool) goto error;
+    }
+    else thread_cnt = 1;
+    if (!maver_adj_joint_init(&supp, wnd, wnd_cnt, phen_cnt, phen_ucnt, thread_cnt)) goto error;
+
+    uint64_t t0 = get_time();
+    maver_adj_joint_impl(&supp, pool, res, gen, phen, phen_cnt, phen_ucnt, rpl, k, seed, 15);
+    uint64_t t1 = get_time();
+    for (size_t i = 0, j = 0; i < top_hit_cnt; i++)
+    {
+        size_t left = top_hit[i].left - 1, right = top_hit[i].right - 1;
+        if (left <= right && right < snp_cnt) categorical_out(f, log, res[j++], i, left, right, t0, t1);
+    }
+    succ = 1;
+
+error:
+    maver_adj_joint_close(&supp);
+    thread_pool_dispose(pool, NULL);
+    free(res);
+    free(wnd);
+    return succ;
+}
+
+bool categorical_run(const char *path_phen, const char *path_gen, const char *path_top_hit, const char *path_out, size_t rpl, double rel_err, size_t mov_wnd, double kernel_sd, bool max, size_t tail, size_t budget, double time_budget, bool cache, uint64_t seed, size_t thread_cnt, bool joint, bool resume, struct log *log)
+{
+    struct thread_pool *pool = NULL;
+    struct categorical_ckpt ckpt = { 0 };
+    struct categorical_null null = { 0 };
+    size_t *gen = NULL, *phen = NULL;
     FILE *f = NULL;
     struct interval *top_hit = NULL;
     struct phen_context phen_context = { 0 };
+    struct maver_adj_supp supp = { 0 };
     size_t phen_skip = 0, phen_cnt = 0, phen_length = 0;
     if (!tbl_read(path_phen, 0, tbl_phen_selector, NULL, &phen_context, &phen, &phen_skip, &phen_cnt, &phen_length, ',', log)) goto error;
 
@@ -142,13 +650,8 @@ bool categorical_run(const char *path_phen, const char *path_gen, const char *pa
     if (!tbl_read(path_top_hit, 0, tbl_top_hit_selector, NULL, &top_hit_cap, &top_hit, &top_hit_skip, &top_hit_cnt, &top_hit_length, ',', log)) goto error;
 
     gsl_set_error_handler(gsl_error_a);
-    rng = gsl_rng_alloc(gsl_rng_taus);
-    if (!rng) goto error;
-    gsl_rng_set(rng, (unsigned long) seed);
-
-    struct maver_adj_supp supp;
 
-    size_t wnd = 0;
+    size_t wnd = 0, wnd_cnt = 0;
     for (size_t i = 0; i < top_hit_cnt; i++)
     {
         size_t left = top_hit[i].left - 1, right = top_hit[i].right - 1;
@@ -158,9 +661,58 @@ bool categorical_run(const char *path_phen, const char *path_gen, const char *pa
         {
             size_t tmp = right - left + 1;
             if (wnd < tmp) wnd = tmp;
+            wnd_cnt++;
         }
     }
 
+    // Count of exceedances is derived from the target relative error of the p-value. Default count is 10
+    size_t k = rel_err > 0. ? maver_adj_stop_cnt(rel_err) : 10;
+
+    // Statistic of the window. Maximum takes precedence over the kernel, and the kernel takes precedence over the moving window
+    struct maver_adj_par par = { .type = MAVER_ADJ_TYPE_MEAN };
+    if (max) par = (struct maver_adj_par) { .type = MAVER_ADJ_TYPE_MAX };
+    else if (kernel_sd > 0.) par = (struct maver_adj_par) { .type = MAVER_ADJ_TYPE_KERNEL, .sd = kernel_sd };
+    else if (mov_wnd) par = (struct maver_adj_par) { .type = MAVER_ADJ_TYPE_MOV, .wnd = mov_wnd };
+    if (max + (kernel_sd > 0.) + !!mov_wnd > 1) log_message_generic(log, CODE_METRIC, MESSAGE_WARNING, "Only one statistic of the window is used!\n");
+    if (joint && par.type != MAVER_ADJ_TYPE_MEAN) log_message_generic(log, CODE_METRIC, MESSAGE_WARNING, "Moving window, kernel, and maximum are not supported in the joint mode and are ignored!\n");
+
+    // Tail approximation requires exact permuted statistics of all replicates, which are not computed by the early exit of the max mode
+    bool sched = budget || time_budget > 0.;
+    if (joint && sched) log_message_generic(log, CODE_METRIC, MESSAGE_WARNING, "Budget of replicates is not supported in the joint mode and is ignored!\n");
+    if (tail && (joint || max || sched))
+    {
+        log_message_generic(log, CODE_METRIC, MESSAGE_WARNING, "Tail approximation is not supported in the joint and the max modes, and under the budget, and is ignored!\n");
+        tail = 0;
+    }
+    if (cache && (joint || max || sched))
+    {
+        log_message_generic(log, CODE_METRIC, MESSAGE_WARNING, "Cache of the null distribution is not supported in the joint and the max modes, and under the budget, and is ignored!\n");
+        cache = 0;
+    }
+    if (cache && resume) log_message_generic(log, CODE_METRIC, MESSAGE_WARNING, "Windows finished before the checkpoint are not written to the cache of the null distribution!\n");
+    if (cache && !categorical_null_init(&null, path_out, top_hit_cnt, log)) goto error;
+
+    // State of the independent mode is saved periodically to the file next to the output. Output is rewritten on resumption
+    if (joint && resume) log_message_generic(log, CODE_METRIC, MESSAGE_WARNING, "Checkpoints are not supported in the joint mode!\n");
+    if (!joint)
+    {
+        struct categorical_ckpt_head head = {
+            .magic = CATEGORICAL_CKPT_MAGIC,
+            .ver = CATEGORICAL_CKPT_VER,
+            .type = par.type,
+            .top_hit_cnt = top_hit_cnt,
+            .snp_cnt = snp_cnt,
+            .phen_cnt = phen_cnt,
+            .rpl = rpl,
+            .k = k,
+            .seed = seed,
+            .wnd = par.wnd,
+            .tail = tail,
+            .sd = par.sd
+        };
+        if (!categorical_ckpt_init(&ckpt, path_out, head, log) || (resume && !categorical_ckpt_load(&ckpt))) goto error;
+    }
+
     f = fopen(path_out, "w");
     for (;;)
     {
@@ -169,36 +721,330 @@ bool categorical_run(const char *path_phen, const char *path_gen, const char *pa
         goto error;
     }
 
-    if (!maver_adj_init(&supp, wnd, phen_cnt, phen_ucnt)) goto error;
 
-    for (size_t i = 0; i < top_hit_cnt; i++)
+    // Windows are distributed between the threads, if there are enough of them. Otherwise, replicates of each window are distributed
+    if (joint) categorical_joint(f, top_hit, top_hit_cnt, wnd_cnt, gen, phen, snp_cnt, phen_cnt, phen_ucnt, rpl, k, seed, thread_cnt, log);
+    else if (sched) categorical_sched(f, &ckpt, top_hit, top_hit_cnt, wnd, gen, phen, snp_cnt, phen_cnt, phen_ucnt, par, rpl, k, seed, budget, time_budget, thread_cnt, log);
+    else if (thread_cnt > 1 && wnd_cnt >= thread_cnt)
     {
-        size_t left = top_hit[i].left - 1, right = top_hit[i].right - 1;
-        if (left > right || right >= snp_cnt) continue;
-
-        uint64_t t0 = get_time();
-        struct maver_adj_res x = maver_adj_impl(&supp, gen + left * phen_cnt, phen, right - left + 1, phen_cnt, phen_ucnt, rpl, 10, rng, 15);
-        log_message_generic(log, CODE_METRIC, MESSAGE_INFO, "Adjusted P-value for window %zu:%zu no. %zu: "
-            "[%s] %f, %zu; [%s] %f, %zu; [%s] %f, %zu; [%s] %f, %zu.\n",
-            left + 1, right + 1, i + 1,
-            "CD", x.nlpv[0], x.rpl[0], "R", x.nlpv[1], x.rpl[1], "D", x.nlpv[2], x.rpl[2], "A", x.nlpv[3], x.rpl[3]);
-        uint64_t t1 = get_time();
-        log_message_time_diff(log, CODE_METRIC, MESSAGE_INFO, t0, t1, "Adjusted P-value computation took ");
+        pool = thread_pool_create(thread_cnt, wnd_cnt, sizeof(struct maver_adj_supp));
+        if (!pool) goto error;
+        struct categorical_wnd_context context = {
+            .pool = pool,
+            .ckpt = &ckpt,
+            .null = cache ? &null : NULL,
+            .top_hit = top_hit,
+            .gen = gen,
+            .phen = phen,
+            .phen_cnt = phen_cnt,
+            .phen_ucnt = phen_ucnt,
+            .snp_cnt = snp_cnt,
+            .par = par,
+            .rpl = rpl,
+            .tail = tail,
+            .k = k,
+            .top_hit_cnt = top_hit_cnt,
+            .seed = seed,
+            .f = f,
+            .log = log
+        };
+        categorical_wnd_mt(&context, wnd, wnd_cnt, thread_cnt);
+    }
+    else
+    {
+        if (thread_cnt > 1)
+        {
+            pool = thread_pool_create(thread_cnt, thread_cnt, 0);
+            if (!pool) goto error;
+        }
+        else thread_cnt = 1;
+        if (!maver_adj_init(&supp, wnd, phen_cnt, phen_ucnt, rpl, tail, cache, thread_cnt)) goto error;
 
-        int64_t diff = t1 - t0, mdq = diff / 60000000, mdr = diff % 60000000;
-        double sec = 1.e-6 * (double) mdr;
-        fprintf(f, "%zu,%.15e,%zu,%.15e,%zu,%.15e,%zu,%.15e,%zu,%" PRId64 " min,%.6f sec\n",
-            i + 1, x.nlpv[0], x.rpl[0], x.nlpv[1], x.rpl[1], x.nlpv[2], x.rpl[2], x.nlpv[3], x.rpl[3], mdq, sec);
-        fflush(f);
+        for (size_t i = 0; i < top_hit_cnt; i++)
+        {
+            size_t left = top_hit[i].left - 1, right = top_hit[i].right - 1;
+            if (left > right || right >= snp_cnt) continue;
+            if (ckpt.wnd[i].done)
+            {
+                categorical_out(f, log, ckpt.wnd[i].res, i, left, right, 0, ckpt.wnd[i].time);
+                continue;
+            }
+
+            uint64_t t0 = get_time();
+            struct maver_adj_res x = categorical_ckpt_impl(&ckpt, i, &supp, pool, gen + left * gen_pack_cnt(phen_cnt), phen, right - left + 1, phen_cnt, phen_ucnt, par, rpl, k, seed + i);
+            uint64_t t1 = get_time();
+            categorical_ckpt_res(&ckpt, i, x, t1 - t0, 1);
+            if (cache) categorical_null_write(&null, i, left, right, &supp, x, rpl);
+            categorical_out(f, log, x, i, left, right, t0, t1);
+        }
     }
+    if (ckpt.wnd) categorical_ckpt_finish(&ckpt, top_hit, snp_cnt);
     
 error:
+    categorical_null_close(&null);
+    categorical_ckpt_close(&ckpt);
     maver_adj_close(&supp);
+    thread_pool_dispose(pool, NULL);
     Fclose(f);
-    gsl_rng_free(rng);
     free(top_hit);
     free(phen_context.handler_context.str);
     free(phen);
     free(gen);
     return 1;
-}
\ No newline at end of file
+}
+
+// Header of the binary output of the genome-wide scan. It is followed by 'snp_cnt' records of 'struct categorical_res' in the native byte order
+struct categorical_scan_head {
+    char magic[8];
+    uint32_t ver, alt_cnt;
+    uint64_t snp_cnt;
+};
+
+#define CATEGORICAL_SCAN_MAGIC "RMTSCAN"
+#define CATEGORICAL_SCAN_VER 1
+#define CATEGORICAL_SCAN_TASK 256 // Count of SNPs processed by a single task
+#define CATEGORICAL_SCAN_BLK 16 // Count of tasks per thread in a block of SNPs
+
+struct categorical_scan_context {
+    struct gen_context gen_context; // Should be the first field, since the context is shared with 'tbl_gen_selector2'
+    struct thread_pool *pool;
+    struct task *tasks;
+    struct categorical_res *res;
+    size_t *gen, *gen_run, gen_run_cap, *phen, phen_cnt, phen_ucnt, blk_cnt, run_off, run_cnt, snp_cnt, pend;
+    FILE *f, *f_csv;
+    struct log *log;
+    mutex_handle mutex;
+    condition_handle condition;
+};
+
+static bool categorical_scan_thread_proc(void *Ind, void *Context)
+{
+    size_t ind = (size_t) (uintptr_t) Ind;
+    struct categorical_scan_context *context = Context;
+    struct categorical_supp *supp = thread_pool_get_thread_data(context->pool, NULL, NULL);
+    size_t off = ind * CATEGORICAL_SCAN_TASK, cnt = MIN(context->run_cnt - off, CATEGORICAL_SCAN_TASK), gen_pack = gen_pack_cnt(context->phen_cnt);
+    for (size_t i = off; i < off + cnt; i++)
+        context->res[i] = categorical_impl(supp, context->gen_run + i * gen_pack, context->phen, context->phen_cnt, context->phen_ucnt, 15);
+    mutex_acquire(&context->mutex);
+    if (!--context->pend) condition_broadcast(&context->condition);
+    mutex_release(&context->mutex);
+    return 1;
+}
+
+// Waits for the running block and writes its results
+static bool categorical_scan_wait(struct categorical_scan_context *context)
+{
+    mutex_acquire(&context->mutex);
+    while (context->pend) condition_sleep(&context->condition, &context->mutex);
+    mutex_release(&context->mutex);
+    if (!context->run_cnt) return 1;
+    if (fwrite(context->res, sizeof(*context->res), context->run_cnt, context->f) != context->run_cnt) return 0;
+    if (context->f_csv) for (size_t i = 0; i < context->run_cnt; i++)
+    {
+        struct categorical_res res = context->res[i];
+        fprintf(context->f_csv, "%zu", context->run_off + i + 1);
+        for (size_t j = 0; j < ALT_CNT; j++) fprintf(context->f_csv, ",%.15e,%.15e", res.nlpv[j], res.qas[j]);
+        fputc('\n', context->f_csv);
+    }
+    context->run_off += context->run_cnt;
+    context->run_cnt = 0;
+    return 1;
+}
+
+// Block of parsed SNPs is passed to the thread pool, while the next one is being parsed to the spare buffer
+static bool categorical_scan_flush(struct categorical_scan_context *context)
+{
+    size_t gen_pack = gen_pack_cnt(context->phen_cnt), cnt = context->gen_context.gen_cnt / gen_pack;
+    if (!categorical_scan_wait(context)) return 0;
+    if (!cnt) return 1;
+    size_t *gen = context->gen, cap = context->gen_context.gen_cap;
+    context->gen = context->gen_run;
+    context->gen_context.gen_cap = context->gen_run_cap;
+    context->gen_context.gen_cnt = 0;
+    context->gen_run = gen;
+    context->gen_run_cap = cap;
+    context->run_cnt = cnt;
+    context->snp_cnt += cnt;
+
+    size_t task_cnt = (cnt + CATEGORICAL_SCAN_TASK - 1) / CATEGORICAL_SCAN_TASK;
+    for (size_t i = 0; i < task_cnt; i++) context->tasks[i] = (struct task) { .callback = categorical_scan_thread_proc, .arg = (void *) (uintptr_t) i, .context = context };
+    context->pend = task_cnt;
+    if (thread_pool_enqueue_tasks(context->pool, context->tasks, task_cnt, 0)) return 1;
+    context->pend = context->run_cnt = 0;
+    return 0;
+}
+
+static bool tbl_gen_scan_eol(size_t row, size_t col, void *tbl, void *Context)
+{
+    (void) row;
+    (void) col;
+    (void) tbl;
+    struct categorical_scan_context *context = Context;
+    if (context->gen_context.gen_cnt < context->blk_cnt * gen_pack_cnt(context->phen_cnt)) return 1;
+    if (categorical_scan_flush(context)) return 1;
+    log_message_crt(context->log, CODE_METRIC, MESSAGE_ERROR, errno);
+    return 0;
+}
+
+// Genome-wide scan: genotypes are streamed by blocks and every SNP is tested independently
+bool categorical_scan(const char *path_phen, const char *path_gen, const char *path_out, const char *path_csv, size_t thread_cnt, struct log *log)
+{
+    bool succ = 0;
+    size_t *phen = NULL;
+    struct phen_context phen_context = { 0 };
+    struct categorical_scan_context context = { .log = log };
+    size_t phen_skip = 0, phen_cnt = 0, phen_length = 0;
+    if (!tbl_read(path_phen, 0, tbl_phen_selector, NULL, &phen_context, &phen, &phen_skip, &phen_cnt, &phen_length, ',', log)) goto error;
+
+    uintptr_t *phen_ptr = pointers_stable(phen, phen_cnt, sizeof(*phen), str_off_stable_cmp, phen_context.handler_context.str);
+    if (!phen_ptr) goto error;
+    size_t phen_ucnt = phen_cnt;
+    ranks_unique_from_pointers_impl(phen, phen_ptr, (uintptr_t) phen, &phen_ucnt, sizeof(*phen), str_off_cmp, phen_context.handler_context.str);
+    free(phen_ptr);
+
+    gsl_set_error_handler(gsl_error_a);
+
+    thread_cnt = MAX(thread_cnt, 1);
+    context.gen_context.phen_cnt = context.phen_cnt = phen_cnt;
+    context.phen_ucnt = phen_ucnt;
+    context.phen = phen;
+    context.blk_cnt = thread_cnt * CATEGORICAL_SCAN_BLK * CATEGORICAL_SCAN_TASK;
+    size_t task_cnt = thread_cnt * CATEGORICAL_SCAN_BLK;
+    if (!array_init(&context.tasks, NULL, task_cnt, sizeof(*context.tasks), 0, ARRAY_STRICT) ||
+        !array_init(&context.res, NULL, context.blk_cnt, sizeof(*context.res), 0, ARRAY_STRICT)) goto error;
+
+    context.f = fopen(path_out, "wb");
+    if (!context.f) log_message_fopen(log, CODE_METRIC, MESSAGE_ERROR, path_out, errno);
+    else if (path_csv && !(context.f_csv = fopen(path_csv, "w"))) log_message_fopen(log, CODE_METRIC, MESSAGE_ERROR, path_csv, errno);
+    else succ = 1;
+    if (!succ) goto error;
+    succ = 0;
+
+    // Header is rewritten when the count of SNPs becomes known
+    struct categorical_scan_head head = { .magic = CATEGORICAL_SCAN_MAGIC, .ver = CATEGORICAL_SCAN_VER, .alt_cnt = ALT_CNT };
+    if (fwrite(&head, sizeof(head), 1, context.f) != 1) goto error;
+
+    context.pool = thread_pool_create(thread_cnt, task_cnt, sizeof(struct categorical_supp));
+    if (!context.pool) goto error;
+    size_t ind = 0;
+    for (; ind < thread_cnt; ind++)
+        if (!categorical_init(thread_pool_fetch_thread_data(context.pool, ind, NULL), phen_cnt, phen_ucnt)) break;
+    if (ind == thread_cnt && mutex_init(&context.mutex))
+    {
+        if (condition_init(&context.condition))
+        {
+            uint64_t t0 = get_time();
+            size_t gen_skip = 0, row_cnt = 0, gen_length = 0;
+            bool rd = tbl_read(path_gen, 0, tbl_gen_selector2, tbl_gen_scan_eol, &context, &context.gen, &gen_skip, &row_cnt, &gen_length, ',', log);
+            if (categorical_scan_flush(&context) && categorical_scan_wait(&context) && rd)
+            {
+                head.snp_cnt = context.snp_cnt;
+                if (!fseek(context.f, 0, SEEK_SET) && fwrite(&head, sizeof(head), 1, context.f) == 1)
+                {
+                    log_message_time_diff(log, CODE_METRIC, MESSAGE_INFO, t0, get_time(), "Scan of %zu SNPs took ", context.snp_cnt);
+                    succ = 1;
+                }
+            }
+            condition_close(&context.condition);
+        }
+        mutex_close(&context.mutex);
+    }
+    while (ind--) categorical_close(thread_pool_fetch_thread_data(context.pool, ind, NULL));
+    if (!succ) log_message_generic(log, CODE_METRIC, MESSAGE_ERROR, "Unable to complete the scan!\n");
+
+error:
+    thread_pool_dispose(context.pool, NULL);
+    Fclose(context.f_csv);
+    Fclose(context.f);
+    free(context.gen_run);
+    free(context.gen);
+    free(context.res);
+    free(context.tasks);
+    free(phen_context.handler_context.str);
+    free(phen);
+    return succ;
+}
+
+// P-values are recomputed from the cache of the null distribution without the permutations. Zero 'rpl' means all cached replicates
+bool categorical_recompute(const char *path_null, const char *path_out, size_t rpl, double rel_err, size_t tail, struct log *log)
+{
+    bool succ = 0;
+    FILE *f = NULL, *f_null = NULL;
+    float *val[ALT_CNT] = { NULL };
+    size_t cap[ALT_CNT] = { 0 };
+    struct categorical_null_rec *rec = NULL;
+    struct maver_adj_res *res = NULL;
+    uint8_t *done = NULL;
+
+    f_null = fopen(path_null, "rb");
+    if (!f_null)
+    {
+        log_message_fopen(log, CODE_METRIC, MESSAGE_ERROR, path_null, errno);
+        goto error;
+    }
+    struct categorical_null_head head;
+    if (fread(&head, sizeof(head), 1, f_null) != 1 || memcmp(head.magic, CATEGORICAL_NULL_MAGIC, sizeof(head.magic)) || head.ver != CATEGORICAL_NULL_VER || head.alt_cnt != ALT_CNT)
+    {
+        log_message_generic(log, CODE_METRIC, MESSAGE_ERROR, "Incompatible cache \"%s\"!\n", path_null);
+        goto error;
+    }
+    size_t top_hit_cnt = (size_t) head.top_hit_cnt;
+    if (!array_init(&rec, NULL, top_hit_cnt, sizeof(*rec), 0, ARRAY_STRICT) ||
+        !array_init(&res, NULL, top_hit_cnt, sizeof(*res), 0, ARRAY_STRICT) ||
+        !array_init(&done, NULL, top_hit_cnt, sizeof(*done), 0, ARRAY_STRICT | ARRAY_CLEAR))
+    {
+        log_message_crt(log, CODE_METRIC, MESSAGE_ERROR, errno);
+        goto error;
+    }
+
+    // Count of exceedances is derived from the target relative error. Otherwise, all cached replicates are used
+    size_t k = rel_err > 0. ? maver_adj_stop_cnt(rel_err) : 0;
+    struct categorical_null_rec tmp;
+    while (fread(&tmp, sizeof(tmp), 1, f_null) == 1)
+    {
+        bool valid = tmp.ind < top_hit_cnt;
+        for (size_t i = 0; valid && i < ALT_CNT; i++)
+        {
+            size_t cnt = (size_t) tmp.cnt[i];
+            if (!array_test(val + i, cap + i, sizeof(*val[i]), 0, 0, cnt))
+            {
+                log_message_crt(log, CODE_METRIC, MESSAGE_ERROR, errno);
+                goto error;
+            }
+            valid = fread(val[i], sizeof(*val[i]), cnt, f_null) == cnt;
+        }
+        if (!valid)
+        {
+            log_message_generic(log, CODE_METRIC, MESSAGE_ERROR, "Corrupted cache \"%s\"!\n", path_null);
+            goto error;
+        }
+        size_t ind = (size_t) tmp.ind, cnt[ALT_CNT];
+        for (size_t i = 0; i < ALT_CNT; i++) cnt[i] = (size_t) tmp.cnt[i];
+        if (!maver_adj_null_res(res + ind, val, cnt, tmp.density, rpl, k, tail))
+        {
+            log_message_crt(log, CODE_METRIC, MESSAGE_ERROR, errno);
+            goto error;
+        }
+        rec[ind] = tmp;
+        done[ind] = 1;
+    }
+
+    f = fopen(path_out, "w");
+    if (!f)
+    {
+        log_message_fopen(log, CODE_METRIC, MESSAGE_ERROR, path_out, errno);
+        goto error;
+    }
+    for (size_t i = 0; i < top_hit_cnt; i++) if (done[i])
+        categorical_out(f, log, res[i], i, (size_t) rec[i].left, (size_t) rec[i].right, 0, 0);
+    succ = 1;
+
+error:
+    Fclose(f);
+    Fclose(f_null);
+    for (size_t i = 0; i < ALT_CNT; i++) free(val[i]);
+    free(rec);
+    free(res);
+    free(done);
+    return succ;
+}
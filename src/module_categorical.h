@@ -3,4 +3,6 @@
 #include "common.h"
 #include "log.h"
 
-bool categorical_run(const char *, const char *, const char *, const char *, size_t, uint64_t, struct log *);
\ No newline at end of file
+bool categorical_run(const char *, const char *, const char *, const char *, size_t, double, size_t, double, bool, size_t, size_t, double, bool, uint64_t, size_t, bool, bool, struct log *);
+bool categorical_recompute(const char *, const char *, size_t, double, size_t, struct log *);
+bool categorical_scan(const char *, const char *, const char *, const char *, size_t, struct log *);
\ No newline at end of file
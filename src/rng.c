@@ -0,0 +1,65 @@
+#include "ll.h"
+#include "rng.h"
+
+static uint64_t uint64_rot_left(uint64_t x, unsigned k)
+{
+    return (x << k) | (x >> (sizeof(x) * CHAR_BIT - k));
+}
+
+void rng_init(struct rng *rng, uint64_t seed)
+{
+    for (size_t i = 0; i < countof(rng->s); i++)
+    {
+        uint64_t x = (seed += 0x9e3779b97f4a7c15ull);
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        rng->s[i] = x ^ (x >> 31);
+    }
+}
+
+uint64_t rng_next(struct rng *rng)
+{
+    uint64_t *s = rng->s, res = uint64_rot_left(s[1] * 5, 7) * 9, t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = uint64_rot_left(s[3], 45);
+    return res;
+}
+
+// Maps the random word 'x' to the range [0, n). New words are drawn only if the rejection is required
+static size_t rng_bounded_impl(struct rng *rng, size_t x, size_t n)
+{
+    size_t hi, lo = size_mul(&hi, x, n);
+    if (lo < n)
+    {
+        size_t thr = (0 - n) % n;
+        while (lo < thr) lo = size_mul(&hi, (size_t) rng_next(rng), n);
+    }
+    return hi;
+}
+
+size_t rng_bounded(struct rng *rng, size_t n)
+{
+    return rng_bounded_impl(rng, (size_t) rng_next(rng), n);
+}
+
+#define RNG_BLK 64
+
+void rng_shuffle(struct rng *rng, size_t *arr, size_t cnt)
+{
+    uint64_t blk[RNG_BLK];
+    for (size_t i = 0; i + 1 < cnt;)
+    {
+        size_t blk_cnt = MIN(cnt - i - 1, RNG_BLK);
+        for (size_t j = 0; j < blk_cnt; blk[j++] = rng_next(rng));
+        for (size_t j = 0; j < blk_cnt; j++, i++)
+        {
+            size_t k = i + rng_bounded_impl(rng, (size_t) blk[j], cnt - i), swp = arr[i];
+            arr[i] = arr[k];
+            arr[k] = swp;
+        }
+    }
+}
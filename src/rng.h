@@ -0,0 +1,22 @@
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Pseudorandom number generator 'xoshiro256**' and the shuffle engine
+//
+
+#include "common.h"
+
+struct rng {
+    uint64_t s[4];
+};
+
+// State is expanded from the seed by the 'splitmix64' generator
+void rng_init(struct rng *, uint64_t);
+uint64_t rng_next(struct rng *);
+
+// Unbiased random integer from the range [0, n) by the Lemire's multiply-shift method. The value of 'n' should be non-zero
+size_t rng_bounded(struct rng *, size_t);
+
+// Performs 'Knuth shuffle' consuming the random numbers by blocks
+void rng_shuffle(struct rng *, size_t *, size_t);
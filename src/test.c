@@ -4,6 +4,7 @@
 #include "memory.h"
 #include "utf8.h"
 #include "test.h"
+#include "test_rng.h"
 
 #include <stdlib.h>
 
@@ -45,7 +46,7 @@ bool perf(struct log *log)
 {
     uint64_t start = get_time();
 
-    // Performance tests here
+    test_rng_perf(log);
 
     log_message_time_diff(log, CODE_METRIC, MESSAGE_INFO, start, get_time(), "Performance tests execution took ");
     return 1;
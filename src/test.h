@@ -19,4 +19,5 @@ struct test_group {
     };
 };
 
-bool test(const struct test_group *, size_t, struct log *);
\ No newline at end of file
+bool test(const struct test_group *, size_t, struct log *);
+bool perf(struct log *);
\ No newline at end of file
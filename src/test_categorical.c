@@ -1,2 +1,355 @@
+#include "np.h"
+#include "categorical.h"
+#include "genotypes.h"
+#include "gslsupp.h"
+#include "memory.h"
+#include "rng.h"
 #include "test.h"
-#include "test_categorical.h"
\ No newline at end of file
+#include "test_categorical.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool test_categorical_generator_b(void *dst, size_t *p_context, struct log *log)
+{
+    (void) log;
+    // Single-point supports, the modes at the ends of the support, and the ties of the symmetric distributions
+    const struct test_categorical_b fixed[] = {
+        { 5, 5, 0, 0 }, { 5, 5, 10, 5 }, { 1, 1, 1, 0 }, { 1, 1, 1, 1 },
+        { 1, 50, 1, 0 }, { 1, 50, 1, 1 }, { 50, 1, 50, 49 }, { 50, 1, 50, 50 }, { 3, 1000, 500, 3 },
+        { 10, 10, 10, 0 }, { 10, 10, 10, 2 }, { 10, 10, 10, 5 }, { 10, 10, 10, 10 }, { 20, 20, 21, 4 },
+        { 30, 70, 20, 0 }, { 30, 70, 20, 20 }, { 200, 300, 150, 40 }, { 200, 300, 150, 75 }
+    };
+    size_t context = *p_context, rnd_cnt = 256;
+    if (context < countof(fixed)) *(struct test_categorical_b *) dst = fixed[context];
+    else
+    {
+        // Random tables with the margins up to 200
+        uint64_t x = (uint64_t) (context + 1) * 0x9e3779b97f4a7c15ull;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        uint32_t n1 = (uint32_t) (x % 200) + 1, n2 = (uint32_t) ((x >> 8) % 200) + 1, t = (uint32_t) ((x >> 16) % (n1 + n2 + 1));
+        uint32_t lo = t > n2 ? t - n2 : 0, hi = MIN(t, n1);
+        *(struct test_categorical_b *) dst = (struct test_categorical_b) { .n1 = n1, .n2 = n2, .t = t, .k = lo + (uint32_t) ((x >> 32) % (hi - lo + 1)) };
+    }
+    if (++*p_context >= countof(fixed) + rnd_cnt) *p_context = 0;
+    return 1;
+}
+
+// Exact test is compared against the direct summation of the hypergeometric probabilities over the whole support
+bool test_categorical_b(void *In, struct log *log)
+{
+    struct test_categorical_b *in = In;
+    double *log_fact = log_fact_tbl_init((size_t) in->n1 + in->n2);
+    if (!log_fact)
+    {
+        log_message_crt(log, CODE_METRIC, MESSAGE_ERROR, errno);
+        return 0;
+    }
+    uint32_t table[] = { in->k, in->n1 - in->k, in->t - in->k, in->n2 - in->t + in->k }, gen_mar[] = { in->t, in->n1 + in->n2 - in->t }, phen_mar[] = { in->n1, in->n2 };
+    double a = stat_exact(table, gen_mar, phen_mar, log_fact), hyp_comp = pdf_hypergeom(in->k, in->n1, in->n2, in->t) * exp(STAT_EXACT_EPS), tot = 0., sum = 0.;
+    free(log_fact);
+    for (size_t i = in->t > in->n2 ? in->t - in->n2 : 0; i <= MIN(in->t, in->n1); i++)
+    {
+        double hyp = pdf_hypergeom(i, in->n1, in->n2, in->t);
+        tot += hyp;
+        if (hyp <= hyp_comp) sum += hyp;
+    }
+    double b = MAX(log10(tot) - log10(sum), 0.);
+    return fabs(a - b) <= TEST_CATEGORICAL_EPS * fmax(b, 1.);
+}
+
+bool test_categorical_generator_c(void *dst, size_t *p_context, struct log *log)
+{
+    (void) log;
+    // Products of the margins exceed 2^32 for the count of samples above 2^17. Strong positive and negative associations, 
+    // missing calls, and the counts of phenotype classes handled by the fixed-size and by the generic kernels. The p-value of the latter 
+    // should not underflow, since the closed form is not used for more than four degrees of freedom
+    const struct test_categorical_c data[] = {
+        { { { 73500, 63000, 13500, 0 }, { 37500, 75000, 37500, 0 } }, 2 },
+        { { { 37500, 75000, 37500, 0 }, { 73500, 63000, 13500, 0 } }, 2 },
+        { { { 73500, 63000, 13500, 0 }, { 73400, 63100, 13500, 0 } }, 2 },
+        { { { 70000, 60000, 15000, 5000 }, { 40000, 70000, 35000, 5000 } }, 2 },
+        { { { 73500, 63000, 13500, 0 }, { 60000, 70000, 20000, 0 }, { 37500, 75000, 37500, 0 } }, 3 },
+        { { { 73500, 63000, 13500, 0 }, { 72000, 63500, 14500, 0 }, { 70500, 64500, 15000, 0 }, { 72000, 63000, 15000, 1000 } }, 4 }
+    };
+    size_t context = *p_context;
+    *(struct test_categorical_c *) dst = data[context];
+    if (++*p_context >= countof(data)) *p_context = 0;
+    return 1;
+}
+
+// Samples are laid out by the counts of the genotypes and of the missing calls for each phenotype class
+static bool test_categorical_run(struct categorical_res *res, uint32_t (*cnt)[GEN_CNT + 1], size_t phen_ucnt, struct log *log)
+{
+    size_t phen_cnt = 0;
+    for (size_t i = 0; i < phen_ucnt; i++) for (size_t j = 0; j < GEN_CNT + 1; phen_cnt += cnt[i][j++]);
+    bool succ = 0;
+    size_t *gen = NULL, *phen = NULL;
+    struct categorical_supp supp = { 0 };
+    if (!array_init(&gen, NULL, gen_pack_cnt(phen_cnt), sizeof(*gen), 0, ARRAY_STRICT | ARRAY_CLEAR) ||
+        !array_init(&phen, NULL, phen_cnt, sizeof(*phen), 0, ARRAY_STRICT) ||
+        !categorical_init(&supp, phen_cnt, phen_ucnt)) // Memory of 'supp' is released on failure
+    {
+        log_message_crt(log, CODE_METRIC, MESSAGE_ERROR, errno);
+        goto error;
+    }
+    for (size_t i = 0, k = 0; i < phen_ucnt; i++) for (size_t j = 0; j < GEN_CNT + 1; j++) for (size_t l = 0; l < cnt[i][j]; l++, k++)
+    {
+        size_t off = (k / SIZE_BIT) << 1, pos = k % SIZE_BIT;
+        gen[off] |= (size_t) (j & 1) << pos;
+        gen[off + 1] |= (size_t) (j >> 1) << pos;
+        phen[k] = i;
+    }
+    *res = categorical_impl(&supp, gen, phen, phen_cnt, phen_ucnt, TEST_TYPE_CODOMINANT | TEST_TYPE_RECESSIVE | TEST_TYPE_DOMINANT | TEST_TYPE_ALLELIC);
+    categorical_close(&supp);
+    succ = 1;
+
+error:
+    free(phen);
+    free(gen);
+    return succ;
+}
+
+// Chi-square p-value and the correlation of the indices of the rows and of the columns are computed in double and compared with the results
+static bool test_categorical_cmp(double res_nlpv, double res_qas, const double (*table)[GEN_CNT], size_t row_cnt, size_t col_cnt)
+{
+    double row[TEST_CATEGORICAL_PHEN_MAX] = { 0. }, col[GEN_CNT] = { 0. }, n = 0.;
+    for (size_t i = 0; i < row_cnt; i++) for (size_t j = 0; j < col_cnt; j++)
+    {
+        row[i] += table[i][j];
+        col[j] += table[i][j];
+        n += table[i][j];
+    }
+    double stat = 0., ms = 0., mt = 0., vs = 0., vt = 0., cov = 0.;
+    for (size_t i = 0; i < row_cnt; i++) for (size_t j = 0; j < col_cnt; j++)
+    {
+        double e = row[i] * col[j] / n;
+        stat += (table[i][j] - e) * (table[i][j] - e) / e;
+        ms += (double) j * table[i][j] / n;
+        mt += (double) i * table[i][j] / n;
+    }
+    for (size_t i = 0; i < row_cnt; i++) for (size_t j = 0; j < col_cnt; j++)
+    {
+        double ds = (double) j - ms, dt = (double) i - mt;
+        vs += ds * ds * table[i][j];
+        vt += dt * dt * table[i][j];
+        cov += ds * dt * table[i][j];
+    }
+    double r = cov / sqrt(vs * vt), nlpv = cdf_chisq_Q_nlog10(stat, (double) ((col_cnt - 1) * (row_cnt - 1))), qas = .5 * (log10(1. - r) - log10(1. + r));
+    return fabs(res_nlpv - nlpv) <= TEST_CATEGORICAL_EPS * fmax(nlpv, 1.) && fabs(res_qas - qas) <= TEST_CATEGORICAL_EPS * fmax(fabs(qas), 1.);
+}
+
+// Tables of the alternatives are derived from the counts
+bool test_categorical_c(void *In, struct log *log)
+{
+    struct test_categorical_c *in = In;
+    const uint8_t coef[ALT_CNT][GEN_CNT][GEN_CNT] = {
+        { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } },
+        { { 1, 1, 0 }, { 0, 0, 1 } },
+        { { 1, 0, 0 }, { 0, 1, 1 } },
+        { { 2, 1, 0 }, { 0, 1, 2 } }
+    };
+    const size_t col_cnt[ALT_CNT] = { 3, 2, 2, 2 };
+    struct categorical_res res;
+    if (!test_categorical_run(&res, in->cnt, in->phen_ucnt, log)) return 0;
+    for (size_t a = 0; a < ALT_CNT; a++)
+    {
+        double table[TEST_CATEGORICAL_PHEN_MAX][GEN_CNT] = { { 0. } };
+        for (size_t i = 0; i < in->phen_ucnt; i++) for (size_t j = 0; j < col_cnt[a]; j++) for (size_t g = 0; g < GEN_CNT; g++)
+            table[i][j] += (double) coef[a][j][g] * (double) in->cnt[i][g];
+        if (!test_categorical_cmp(res.nlpv[a], res.qas[a], table, in->phen_ucnt, col_cnt[a])) return 0;
+    }
+    return 1;
+}
+
+bool test_categorical_generator_d(void *dst, size_t *p_context, struct log *log)
+{
+    (void) log;
+    // All genotypes, and the sets of two genotypes, for which the empty columns are dropped. Tables are computed by hand
+    const struct test_categorical_d data[] = {
+        {
+            { { 30, 40, 20 }, { 20, 45, 35 } },
+            { { { 30, 40, 20 }, { 20, 45, 35 } }, { { 70, 20 }, { 65, 35 } }, { { 30, 60 }, { 20, 80 } }, { { 100, 80 }, { 85, 115 } } },
+            { 3, 2, 2, 2 }
+        },
+        {
+            { { 0, 15, 25 }, { 0, 30, 10 } },
+            { { { 15, 25 }, { 30, 10 } }, { { 15, 25 }, { 30, 10 } }, { { 0 } }, { { 15, 65 }, { 30, 50 } } },
+            { 2, 2, 0, 2 }
+        },
+        {
+            { { 35, 0, 15 }, { 20, 0, 30 } },
+            { { { 35, 15 }, { 20, 30 } }, { { 35, 15 }, { 20, 30 } }, { { 35, 15 }, { 20, 30 } }, { { 70, 30 }, { 40, 60 } } },
+            { 2, 2, 2, 2 }
+        },
+        {
+            { { 40, 25, 0 }, { 30, 45, 0 } },
+            { { { 40, 25 }, { 30, 45 } }, { { 0 } }, { { 40, 25 }, { 30, 45 } }, { { 105, 25 }, { 105, 45 } } },
+            { 2, 0, 2, 2 }
+        }
+    };
+    size_t context = *p_context;
+    *(struct test_categorical_d *) dst = data[context];
+    if (++*p_context >= countof(data)) *p_context = 0;
+    return 1;
+}
+
+// Tables, margins, and statistics of the alternatives are compared with the expected ones
+bool test_categorical_d(void *In, struct log *log)
+{
+    struct test_categorical_d *in = In;
+    uint8_t gen_bits[UINT8_CNT(GEN_CNT)] = { 0 };
+    uint32_t src[2 * GEN_CNT], cnt[2][GEN_CNT + 1] = { { 0 } }, gen_pop_cnt_alt[ALT_CNT], dst[ALT_CNT * GEN_CNT * 2], gen_mar[ALT_CNT][GEN_CNT] = { { 0 } }, phen_mar[ALT_CNT * 2];
+    for (size_t i = 0; i < 2; i++) for (size_t j = 0; j < GEN_CNT; j++)
+    {
+        src[GEN_CNT * i + j] = cnt[i][j] = in->base[i][j];
+        if (in->base[i][j]) uint8_bit_set(gen_bits, j);
+    }
+    gen_pop_cnt_alt_init(gen_pop_cnt_alt, gen_bits, TEST_TYPE_CODOMINANT | TEST_TYPE_RECESSIVE | TEST_TYPE_DOMINANT | TEST_TYPE_ALLELIC);
+    if (memcmp(gen_pop_cnt_alt, in->gen_pop_cnt, sizeof(gen_pop_cnt_alt))) return 0;
+    contingency_table_alt_init(dst, gen_mar, phen_mar, src, gen_bits, gen_pop_cnt_alt, NULL, 2);
+    
+    struct categorical_res res;
+    if (!test_categorical_run(&res, cnt, 2, log)) return 0;
+    for (size_t a = 0; a < ALT_CNT; a++)
+    {
+        size_t gen_pop_cnt = gen_pop_cnt_alt[a];
+        if (!gen_pop_cnt)
+        {
+            if (!isnan(res.nlpv[a])) return 0;
+            continue;
+        }
+        double table[TEST_CATEGORICAL_PHEN_MAX][GEN_CNT] = { { 0. } };
+        for (size_t i = 0; i < 2; i++)
+        {
+            uint32_t tot = 0;
+            for (size_t j = 0; j < gen_pop_cnt; j++)
+            {
+                uint32_t el = in->table[a][i][j];
+                if (dst[a * GEN_CNT * 2 + gen_pop_cnt * i + j] != el) return 0;
+                table[i][j] = (double) el;
+                tot += el;
+            }
+            if (phen_mar[a * 2 + i] != tot) return 0;
+        }
+        for (size_t j = 0; j < gen_pop_cnt; j++) if (gen_mar[a][j] != in->table[a][0][j] + in->table[a][1][j]) return 0;
+        if (!test_categorical_cmp(res.nlpv[a], res.qas[a], table, 2, gen_pop_cnt)) return 0;
+    }
+    return 1;
+}
+
+bool test_categorical_generator_e(void *dst, size_t *p_context, struct log *log)
+{
+    (void) log;
+    // Full and partial blocks, the count of samples not divisible by the word size, common and rare genotypes, and the missing calls
+    const struct test_categorical_e data[] = {
+        { 1000, MAVER_ADJ_BLK, .3, 0., 1 },
+        { 1000, MAVER_ADJ_BLK, .05, .02, 2 },
+        { 777, 37, .02, .1, 3 },
+        { 64, MAVER_ADJ_BLK, .4, 0., 4 },
+        { 130, 1, .1, .05, 5 },
+        { 5000, MAVER_ADJ_BLK, .01, 0., 6 },
+        { 3001, 63, .25, .3, 7 }
+    };
+    size_t context = *p_context;
+    *(struct test_categorical_e *) dst = data[context];
+    if (++*p_context >= countof(data)) *p_context = 0;
+    return 1;
+}
+
+static double test_categorical_rng_unif(struct rng *rng)
+{
+    return (double) (rng_next(rng) >> 11) * 0x1p-53;
+}
+
+// Transposition is compared against the naive one
+bool test_categorical_e_1(void *In, struct log *log)
+{
+    (void) log;
+    struct test_categorical_e *in = In;
+    struct rng rng;
+    rng_init(&rng, in->seed);
+    uint64_t a[MAVER_ADJ_BLK], b[MAVER_ADJ_BLK];
+    for (size_t i = 0; i < MAVER_ADJ_BLK; i++) a[i] = b[i] = rng_next(&rng);
+    bits_transpose(a);
+    for (size_t i = 0; i < MAVER_ADJ_BLK; i++) for (size_t j = 0; j < MAVER_ADJ_BLK; j++)
+        if (((a[i] >> j) & 1) != ((b[j] >> i) & 1)) return 0;
+    return 1;
+}
+
+// Vertical counters are compared against the sums of the bits of the lanes
+bool test_categorical_e_2(void *In, struct log *log)
+{
+    (void) log;
+    struct test_categorical_e *in = In;
+    struct rng rng;
+    rng_init(&rng, in->seed);
+    size_t bits = size_bit_scan_reverse(in->phen_cnt) + 1;
+    uint64_t cnt[sizeof(uint32_t) * CHAR_BIT] = { 0 };
+    uint32_t sum[MAVER_ADJ_BLK] = { 0 }, res[MAVER_ADJ_BLK];
+    for (size_t i = 0; i < in->phen_cnt; i++)
+    {
+        uint64_t x = rng_next(&rng) & rng_next(&rng);
+        vert_add(cnt, x);
+        for (size_t r = 0; r < MAVER_ADJ_BLK; r++) sum[r] += (x >> r) & 1;
+    }
+    vert_get(res, cnt, bits, in->rpl_cnt);
+    return !memcmp(res, sum, in->rpl_cnt * sizeof(*res));
+}
+
+// Tables of the block obtained by the vertical counters and by the transposition are compared against the tables of the permutations built one at a time
+bool test_categorical_e_3(void *In, struct log *log)
+{
+    struct test_categorical_e *in = In;
+    size_t phen_cnt = in->phen_cnt, rpl_cnt = in->rpl_cnt, wcnt = TYPE_CNT(phen_cnt, SIZE_BIT), cnt = 0, phen_cnt0 = 0;
+    bool succ = 0;
+    size_t *gen = NULL, *phen = NULL, *perm = NULL, *perm_mask = NULL, *phen_mask = NULL;
+    uint64_t *perm_bits = NULL;
+    if (!array_init(&gen, NULL, gen_pack_cnt(phen_cnt), sizeof(*gen), 0, ARRAY_STRICT | ARRAY_CLEAR) ||
+        !array_init(&phen, NULL, phen_cnt, sizeof(*phen), 0, ARRAY_STRICT) ||
+        !array_init(&perm, NULL, phen_cnt, sizeof(*perm), 0, ARRAY_STRICT) ||
+        !array_init(&perm_bits, NULL, wcnt, SIZE_BIT * sizeof(*perm_bits), 0, ARRAY_STRICT | ARRAY_CLEAR) ||
+        !array_init(&perm_mask, NULL, MAVER_ADJ_BLK, wcnt * sizeof(*perm_mask), 0, ARRAY_STRICT) ||
+        !array_init(&phen_mask, NULL, 2, wcnt * sizeof(*phen_mask), 0, ARRAY_STRICT))
+    {
+        log_message_crt(log, CODE_METRIC, MESSAGE_ERROR, errno);
+        goto error;
+    }
+
+    struct rng rng;
+    rng_init(&rng, in->seed);
+    uint32_t gen_tot[GEN_CNT] = { 0 }, ref[MAVER_ADJ_BLK][2 * GEN_CNT], vert[MAVER_ADJ_BLK][2 * GEN_CNT], trans[MAVER_ADJ_BLK][2 * GEN_CNT];
+    for (size_t i = 0; i < phen_cnt; i++)
+    {
+        size_t g = test_categorical_rng_unif(&rng) < in->miss ? GEN_PACK_MISSING : (test_categorical_rng_unif(&rng) < in->freq) + (test_categorical_rng_unif(&rng) < in->freq);
+        size_t off = (i / SIZE_BIT) << 1, pos = i % SIZE_BIT;
+        gen[off] |= (size_t) (g & 1) << pos;
+        gen[off + 1] |= (size_t) (g >> 1) << pos;
+        if (g != GEN_PACK_MISSING) gen_tot[g]++, cnt++;
+        phen_cnt0 += !(phen[i] = i % 3 != 0);
+    }
+    for (size_t r = 0; r < rpl_cnt; r++)
+    {
+        memcpy(perm, phen, phen_cnt * sizeof(*perm));
+        rng_shuffle(&rng, perm, phen_cnt);
+        for (size_t i = 0; i < phen_cnt; i++) perm_bits[i] |= (uint64_t) !perm[i] << r;
+        phen_mask_init(phen_mask, perm, phen_cnt, 2);
+        contingency_table_pop_cnt(ref[r], gen, phen_mask, NULL, phen_cnt, 2);
+    }
+    contingency_table_blk(vert[0], gen, perm_bits, NULL, gen_tot, phen_cnt, phen_cnt0, cnt, rpl_cnt, 1);
+    perm_mask_init(perm_mask, perm_bits, phen_cnt, rpl_cnt);
+    contingency_table_blk(trans[0], gen, perm_bits, perm_mask, gen_tot, phen_cnt, phen_cnt0, cnt, rpl_cnt, 0);
+    succ = !memcmp(vert, ref, rpl_cnt * sizeof(*ref)) && !memcmp(trans, ref, rpl_cnt * sizeof(*ref));
+
+error:
+    free(phen_mask);
+    free(perm_mask);
+    free(perm_bits);
+    free(perm);
+    free(phen);
+    free(gen);
+    return succ;
+}
\ No newline at end of file
@@ -1,8 +1,45 @@
 #pragma once
 
+#include "categorical.h"
 #include "log.h"
 
 struct test_categorical_a {
     double a, b;
     int res_dsc, res_dsc_abs, res_dsc_nan;
-};
\ No newline at end of file
+};
+
+struct test_categorical_b {
+    uint32_t n1, n2, t, k; // Margins of the first row, the second row, the first column, and the upper left cell
+};
+
+#define TEST_CATEGORICAL_PHEN_MAX 4
+
+struct test_categorical_c {
+    uint32_t cnt[TEST_CATEGORICAL_PHEN_MAX][GEN_CNT + 1]; // Counts of the genotypes '0', '1', '2' and of the missing calls for each phenotype class
+    size_t phen_ucnt;
+};
+
+struct test_categorical_d {
+    uint32_t base[2][GEN_CNT]; // Table of the genotypes for the case/control phenotype
+    uint32_t table[ALT_CNT][2][GEN_CNT]; // Expected tables of the alternatives without the empty columns
+    uint32_t gen_pop_cnt[ALT_CNT]; // Expected counts of the columns. Zero if the alternative is not tested
+};
+
+struct test_categorical_e {
+    size_t phen_cnt, rpl_cnt;
+    double freq, miss; // Frequency of the allele and of the missing calls
+    uint64_t seed;
+};
+
+#define TEST_CATEGORICAL_EPS 1e-10
+
+bool test_categorical_generator_b(void *, size_t *, struct log *);
+bool test_categorical_b(void *, struct log *);
+bool test_categorical_generator_c(void *, size_t *, struct log *);
+bool test_categorical_c(void *, struct log *);
+bool test_categorical_generator_d(void *, size_t *, struct log *);
+bool test_categorical_d(void *, struct log *);
+bool test_categorical_generator_e(void *, size_t *, struct log *);
+bool test_categorical_e_1(void *, struct log *);
+bool test_categorical_e_2(void *, struct log *);
+bool test_categorical_e_3(void *, struct log *);
\ No newline at end of file
@@ -0,0 +1,24 @@
+#include "np.h"
+#include "gslsupp.h"
+#include "test_gslsupp.h"
+
+#include <math.h>
+
+bool test_gslsupp_generator_a(void *dst, size_t *p_context, struct log *log)
+{
+    (void) log;
+    const double x[] = { 1.e-10, 1.e-3, .1, .5, 1., 2., 3.5, 5., 10., 20., 50., 100., 200., 500., 1000., 1400. };
+    size_t context = *p_context, df_cnt = 4;
+    *(struct test_gslsupp_a *) dst = (struct test_gslsupp_a) { .x = x[context / df_cnt], .df = (double) (context % df_cnt + 1) };
+    if (++*p_context >= countof(x) * df_cnt) *p_context = 0;
+    return 1;
+}
+
+// Closed forms are tested against the general algorithm from GSL
+bool test_gslsupp_a(void *In, struct log *log)
+{
+    (void) log;
+    struct test_gslsupp_a *in = In;
+    double a = cdf_chisq_Q_nlog10(in->x, in->df), b = -log10(cdf_chisq_Q(in->x, in->df));
+    return fabs(a - b) <= TEST_GSLSUPP_EPS * fmax(fabs(b), 1.);
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "log.h"
+
+struct test_gslsupp_a {
+    double x, df;
+};
+
+#define TEST_GSLSUPP_EPS 1e-10
+
+bool test_gslsupp_generator_a(void *, size_t *, struct log *);
+bool test_gslsupp_a(void *, struct log *);
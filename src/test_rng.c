@@ -0,0 +1,111 @@
+#include "np.h"
+#include "ll.h"
+#include "memory.h"
+#include "rng.h"
+#include "test_rng.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gsl/gsl_rng.h>
+
+bool test_rng_generator_a(void *dst, size_t *p_context, struct log *log)
+{
+    (void) log;
+    const size_t cnt[] = { 1, 2, 3, 63, 64, 65, 1000, 100000 };
+    size_t context = *p_context, seed_cnt = 3;
+    *(struct test_rng_a *) dst = (struct test_rng_a) { .seed = context % seed_cnt, .cnt = cnt[context / seed_cnt] };
+    if (++*p_context >= countof(cnt) * seed_cnt) *p_context = 0;
+    return 1;
+}
+
+// Shuffle should produce the same permutation from the same seed
+bool test_rng_a_1(void *In, struct log *log)
+{
+    struct test_rng_a *in = In;
+    bool succ = 0;
+    size_t *a = NULL, *b = NULL;
+    uint8_t *bits = NULL;
+    if (!array_init(&a, NULL, in->cnt, sizeof(*a), 0, ARRAY_STRICT) ||
+        !array_init(&b, NULL, in->cnt, sizeof(*b), 0, ARRAY_STRICT) ||
+        !array_init(&bits, NULL, UINT8_CNT(in->cnt), sizeof(*bits), 0, ARRAY_STRICT | ARRAY_CLEAR)) log_message_crt(log, CODE_METRIC, MESSAGE_ERROR, errno);
+    else
+    {
+        struct rng rng;
+        for (size_t i = 0; i < in->cnt; i++) a[i] = b[i] = i;
+        rng_init(&rng, in->seed);
+        rng_shuffle(&rng, a, in->cnt);
+        rng_init(&rng, in->seed);
+        rng_shuffle(&rng, b, in->cnt);
+        size_t i = 0;
+        for (; i < in->cnt && a[i] == b[i] && a[i] < in->cnt && !uint8_bit_test_set(bits, a[i]); i++);
+        succ = i == in->cnt;
+    }
+    free(bits);
+    free(b);
+    free(a);
+    return succ;
+}
+
+bool test_rng_a_2(void *In, struct log *log)
+{
+    (void) log;
+    struct test_rng_a *in = In;
+    struct rng rng;
+    rng_init(&rng, in->seed);
+    for (size_t i = 0; i < 64; i++) if (rng_bounded(&rng, in->cnt) >= in->cnt) return 0;
+    return 1;
+}
+
+// Reference values are produced by the original implementation of 'xoshiro256**'
+bool test_rng_generator_b(void *dst, size_t *p_context, struct log *log)
+{
+    (void) log;
+    *(struct test_rng_b *) dst = (struct test_rng_b) { 
+        .s = { 1, 2, 3, 4 }, 
+        .res = { 11520, 0, 1509978240, 1215971899390074240ull, 1216172134540287360ull, 607988272756665600ull } 
+    };
+    *p_context = 0;
+    return 1;
+}
+
+bool test_rng_b(void *In, struct log *log)
+{
+    (void) log;
+    struct test_rng_b *in = In;
+    struct rng rng;
+    memcpy(rng.s, in->s, sizeof(rng.s));
+    for (size_t i = 0; i < countof(in->res); i++) if (rng_next(&rng) != in->res[i]) return 0;
+    return 1;
+}
+
+#define TEST_RNG_PERF_CNT 100000
+#define TEST_RNG_PERF_RPL 200
+
+// Compares the shuffle engine with the previous implementation based on 'gsl_rng_taus'
+void test_rng_perf(struct log *log)
+{
+    size_t *arr = NULL;
+    gsl_rng *gsl = gsl_rng_alloc(gsl_rng_taus);
+    if (!gsl || !array_init(&arr, NULL, TEST_RNG_PERF_CNT, sizeof(*arr), 0, ARRAY_STRICT)) log_message_crt(log, CODE_METRIC, MESSAGE_ERROR, errno);
+    else
+    {
+        for (size_t i = 0; i < TEST_RNG_PERF_CNT; i++) arr[i] = i;
+        uint64_t start = get_time();
+        for (size_t k = 0; k < TEST_RNG_PERF_RPL; k++) for (size_t i = 0; i < TEST_RNG_PERF_CNT - 1; i++)
+        {
+            size_t j = i + (size_t) floor(gsl_rng_uniform(gsl) * (TEST_RNG_PERF_CNT - i)), swp = arr[i];
+            arr[i] = arr[j];
+            arr[j] = swp;
+        }
+        uint64_t mid = get_time();
+        struct rng rng;
+        rng_init(&rng, 0);
+        for (size_t k = 0; k < TEST_RNG_PERF_RPL; k++) rng_shuffle(&rng, arr, TEST_RNG_PERF_CNT);
+        uint64_t stop = get_time();
+        log_message_generic(log, CODE_METRIC, MESSAGE_INFO, "Shuffles of %zu elements per second: %.1f ('gsl_rng_taus'), %.1f ('xoshiro256**').\n", (size_t) TEST_RNG_PERF_CNT, 1.e6 * TEST_RNG_PERF_RPL / (double) MAX(mid - start, 1), 1.e6 * TEST_RNG_PERF_RPL / (double) MAX(stop - mid, 1));
+    }
+    free(arr);
+    gsl_rng_free(gsl);
+}
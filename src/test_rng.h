@@ -0,0 +1,21 @@
+#pragma once
+
+#include "log.h"
+
+struct test_rng_a {
+    uint64_t seed;
+    size_t cnt;
+};
+
+bool test_rng_generator_a(void *, size_t *, struct log *);
+bool test_rng_a_1(void *, struct log *);
+bool test_rng_a_2(void *, struct log *);
+
+struct test_rng_b {
+    uint64_t s[4], res[6];
+};
+
+bool test_rng_generator_b(void *, size_t *, struct log *);
+bool test_rng_b(void *, struct log *);
+
+void test_rng_perf(struct log *);
\ No newline at end of file
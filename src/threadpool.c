@@ -90,13 +90,13 @@ static void task_queue_enqueue_hi(struct task_queue *restrict queue, struct task
     size_t left = queue->begin + queue->cap - cnt;
     if (left >= queue->cap) left -= queue->cap;
         
-    if (left > queue->begin)
+    if (left + cnt > queue->cap)
     {
         for (size_t i = left; i < queue->cap; queue->tasks[i++] = newtasks++);
-        for (size_t i = 0; i < queue->begin; queue->tasks[i++] = newtasks++);
+        for (size_t i = 0; i < left + cnt - queue->cap; queue->tasks[i++] = newtasks++);
     }
     else
-        for (size_t i = left; i < queue->begin; queue->tasks[i++] = newtasks++);
+        for (size_t i = left; i < left + cnt; queue->tasks[i++] = newtasks++);
 
     queue->begin = left;
     queue->cnt += cnt;    
@@ -185,6 +185,19 @@ void *thread_pool_get_thread_data(struct thread_pool *pool, size_t *p_thread_id,
     return NULL;
 }
 
+// Returns pointer to the thread-local data for the thread with the given identifier (commonly used to initialize and dispose the data from the main thread)
+void *thread_pool_fetch_thread_data(struct thread_pool *pool, size_t thread_id, size_t *p_thread_data_sz)
+{
+    if (thread_id >= pool->cnt)
+    {
+        if (p_thread_data_sz) *p_thread_data_sz = 0;
+        return NULL;
+    }
+    struct thread_storage *storage = pool->storage[thread_id];
+    if (p_thread_data_sz) *p_thread_data_sz = storage->data_sz;
+    return storage->data;
+}
+
 static inline size_t threadproc_startup(struct thread_pool *pool)
 {
     size_t res = SIZE_MAX;    
@@ -25,3 +25,4 @@ size_t thread_pool_dispose(struct thread_pool *, size_t *);
 size_t thread_pool_get_count(struct thread_pool *);
 size_t thread_pool_get_thread_id(struct thread_pool *);
 void *thread_pool_get_thread_data(struct thread_pool *, size_t *, size_t *);
+void *thread_pool_fetch_thread_data(struct thread_pool *, size_t, size_t *);